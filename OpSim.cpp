@@ -10,367 +10,5701 @@
 #include <fstream>
 #include <string>
 #include <queue>
+#include <deque>
+#include <set>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <string_view>
+#include <climits>
+#include <cctype>
+#include <cstddef>
 #include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <new>
 
 using namespace std;
-enum state { newP, running, waiting, ready, terminated };
+
+// Every heap allocation is counted on the thread that makes it. A run adds up the counts of its own
+// threads, so it can show that scheduling allocates nothing once its queues have grown to the size
+// of the workload, and simulations running side by side don't count each other's allocations.
+thread_local long long threadAllocations = 0;
+
+// kept out of line, gcc warns about mismatched new and delete when it inlines malloc and free into callers
+__attribute__((noinline)) void *operator new(size_t size) {
+    threadAllocations++;
+    void *p = malloc(size > 0 ? size : 1);
+    if (p == nullptr) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+__attribute__((noinline)) void *operator new(size_t size, align_val_t align) {
+    threadAllocations++;
+    size_t a = max((size_t) align, sizeof(void *));
+    void *p = aligned_alloc(a, (size + a - 1) / a * a);
+    if (p == nullptr) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+// the nothrow forms have to come from the same malloc, the library's would be freed by the delete below
+__attribute__((noinline)) void *operator new(size_t size, const nothrow_t &) noexcept {
+    threadAllocations++;
+    return malloc(size > 0 ? size : 1);
+}
+
+__attribute__((noinline)) void *operator new(size_t size, align_val_t align, const nothrow_t &) noexcept {
+    threadAllocations++;
+    size_t a = max((size_t) align, sizeof(void *));
+    return aligned_alloc(a, (size + a - 1) / a * a);
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, align_val_t) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t, align_val_t) noexcept {
+    free(p);
+}
+
+enum state { newP, running, waiting, ready, terminated, blocked, sleeping };
 // newP: the process is being created
 // running: instructions are being executed
 // waiting: the process is waiting for some event to occur
 // ready: the process is waiting to be assigned a to a processor (first time the process goes into memory))
 // terminated: the process has finished executing
+// blocked: the process is waiting for the lock of its critical section
+// sleeping: the process is in a SLEEP of its program until a CPU clock reaches the end of it
+
+
+// Interned process names. Every distinct name is stored once and processes keep its small integer
+// id, so loading or generating millions of processes with the same few names allocates nothing per
+// process. Names live in a deque so the views used as map keys never move.
+class NameTable {
+    public:
+        deque<string> names;
+        unordered_map<string_view, int> index;
+        mutex nameLock; // interning happens while the trace writer may be reading names
+
+        int intern(string_view name) {
+            nameLock.lock();
+            auto found = index.find(name);
+            int id;
+            if (found != index.end()) {
+                id = found->second;
+            } else {
+                id = names.size();
+                names.push_back(string(name));
+                index[string_view(names.back())] = id;
+            }
+            nameLock.unlock();
+            return id;
+        }
+
+        // only safe from the thread that interns or with nameLock held
+        const string &name(int id) {
+            return names[id];
+        }
+
+        int size() {
+            return names.size();
+        }
+};
+
+NameTable Names; // every process name the simulator has seen
+
+// Program scripts from programFiles. The first line is the RAM the program needs and every line
+// after it is one operation: CALCULATE <cycles>, I/O, YIELD, SLEEP <cycles> or OUT <message>. A script is compiled
+// once into a run of packed instructions, the operation in the low bits and its operand above it,
+// and every process running the program points straight into that code. OUT messages are interned
+// in Names so the trace writer can print them.
+enum programOp { opCalculate, opIO, opYield, opOut, opEnd, opSleep };
+const int opBits = 3; // the operation takes the low opBits bits of an instruction
+const int opMask = (1 << opBits) - 1;
+const int maxOperand = INT_MAX >> opBits;
+
+class ProgramTable {
+    public:
+        deque<vector<int>> code; // instructions of each program, a deque so running processes' pointers never move
+        vector<int> ram; // RAM each program needs in MB
+        vector<int> cycles; // CALCULATE cycles in each program
+        vector<int> pathId; // file each program was compiled from, an id in Names
+        unordered_map<string, int> byPath; // every file is compiled once
+        string error; // set when a program fails to compile
+
+        // compiles the program file at path, returns its id or -1 with error set
+        int load(const string &path) {
+            auto found = byPath.find(path);
+            if (found != byPath.end()) {
+                return found->second;
+            }
+            ifstream file(path);
+            if (!file.is_open()) {
+                error = "program file not found: " + path;
+                return -1;
+            }
+            vector<int> instructions;
+            string line;
+            int lineNumber = 0;
+            int programRam = -1;
+            long long total = 0;
+            while (getline(file, line)) {
+                lineNumber++;
+                stringstream words(line);
+                string op;
+                if (!(words >> op)) {
+                    continue; // blank lines are allowed
+                }
+                string where = path + ":" + to_string(lineNumber) + ": ";
+                long long operand = 0;
+                if (programRam < 0) {
+                    if (!number(op, operand) || operand < 0 || operand > INT_MAX) {
+                        error = where + "the first line must be the RAM size, got '" + op + "'";
+                        return -1;
+                    }
+                    programRam = operand;
+                } else if (op == "CALCULATE") {
+                    string count;
+                    words >> count;
+                    if (!number(count, operand) || operand < 0 || operand > maxOperand) {
+                        error = where + "CALCULATE expects a number of cycles, got '" + count + "'";
+                        return -1;
+                    }
+                    instructions.push_back(opCalculate | operand << opBits);
+                    total += operand;
+                } else if (op == "I/O") {
+                    instructions.push_back(opIO);
+                } else if (op == "YIELD") {
+                    instructions.push_back(opYield);
+                } else if (op == "SLEEP") {
+                    string count;
+                    words >> count;
+                    if (!number(count, operand) || operand < 0 || operand > maxOperand) {
+                        error = where + "SLEEP expects a number of cycles, got '" + count + "'";
+                        return -1;
+                    }
+                    instructions.push_back(opSleep | operand << opBits);
+                } else if (op == "OUT") {
+                    string message;
+                    getline(words >> ws, message);
+                    instructions.push_back(opOut | Names.intern(message) << opBits);
+                } else {
+                    error = where + "unknown operation '" + op + "'";
+                    return -1;
+                }
+            }
+            if (programRam < 0) {
+                error = path + ": empty program";
+                return -1;
+            }
+            if (total > INT_MAX) {
+                error = path + ": the program runs for too many cycles";
+                return -1;
+            }
+            instructions.push_back(opEnd);
+            return add(path, move(instructions), programRam, total);
+        }
+
+        // adds compiled code for the program file at path, returns its id
+        int add(const string &path, vector<int> instructions, int programRam, int total) {
+            int id = code.size();
+            code.push_back(move(instructions));
+            ram.push_back(programRam);
+            cycles.push_back(total);
+            pathId.push_back(Names.intern(path));
+            byPath[path] = id;
+            return id;
+        }
+
+        const int *start(int program) {
+            return code[program].data();
+        }
+
+        int size() {
+            return code.size();
+        }
+
+    private:
+        bool number(const string &word, long long &value) {
+            if (word.empty() || word.size() > 12 || word.find_first_not_of("0123456789") != string::npos) {
+                return false;
+            }
+            value = stoll(word);
+            return true;
+        }
+};
+
+ProgramTable Programs; // every program script that has been compiled
+
+// Everything a job file or the generator says about one process before it gets a table slot.
+struct JobSpec {
+    string_view name = "default";
+    int cycles = -1;
+    int priority = -1;
+    int criticalStart = -1;
+    int criticalLength = 0;
+    int inputOutput = -1;
+    long long arrival = 0; // simulated time the process arrives
+    int program = -1; // program the process runs, an id in Programs, -1 to just run for cycles
+    int lock = 0; // simulated lock the critical section takes, -1 for none
+    uint64_t affinity = 0; // bit c is set for each CPU c the process may run on, 0 for any
+};
+
+// reads a list of CPUs like 0,2-3 into a mask with bit c set for CPU c, false if it isn't one
+bool parseCPUList(string_view text, uint64_t &mask) {
+    mask = 0;
+    size_t pos = 0;
+    while (pos <= text.size()) {
+        size_t end = min(text.find(',', pos), text.size());
+        string_view item = text.substr(pos, end - pos);
+        size_t dash = item.find('-');
+        string_view low = item.substr(0, dash), high = dash == string_view::npos ? low : item.substr(dash + 1);
+        if (low.empty() || high.empty() || low.size() > 2 || high.size() > 2
+                || low.find_first_not_of("0123456789") != string_view::npos || high.find_first_not_of("0123456789") != string_view::npos) {
+            return false;
+        }
+        int first = stoi(string(low)), last = stoi(string(high));
+        if (first > last || last > 63) {
+            return false;
+        }
+        for (int c = first; c <= last; c++) {
+            mask |= 1ULL << c;
+        }
+        pos = end + 1;
+    }
+    return true;
+}
 
+// latest simulated time a restored checkpoint may hold. It is far more than any run takes and leaves the
+// totals a run sums up from its times, like lock wait cycles, room to grow without overflowing.
+const long long maxRestoredTime = 1LL << 48;
 
-class Process {
+// Process table holding every PCB. A process lives in one slot of the table and the ready queue,
+// run queues, memory and io device only pass the slot's integer handle around, so nothing is copied
+// or allocated per dispatch. The fields are parallel arrays: the counters touched on every dispatch
+// are packed together and the metadata that is only read when printing is kept apart from them.
+class ProcessTable {
 public:
-    int pid; // process ID number
-    int totalCycles; // total number of cycles it takes to finish a process
-    int remainingCycles; // number of cycles remaining before a process is complete
-    string processName; // name of the process
-    state pState; // state the process is in [ running, waiting, ready, terminated ] 
-    int priority; // priority of the process: 0 = low, 1 = medium, 2 = high
-    int criticalStart; // critical section has a start cycle
-    int criticalLength; // critical section has a length in cycles
-    int memory; // memory usage in MB
-    int inputOutput; // cycle location where the io interrupt is
-
-    // Process constructor
-	Process(int p, int tc, string name, int pr, int cs, int cl, int io) {
-        pid = p;
-        totalCycles = tc;
-        remainingCycles = tc; // remainingCycles is always the same as totalCycles at creation
-        pState = newP;
-        processName = name;
-        priority = pr;
-        criticalStart = cs;
-        criticalLength = cl;
-        memory = 1;
-        inputOutput = io;
-    }
-
-    void printProcess() {
-        cout << "\nProcess ID: " << pid;
-        cout << "\nProcess Name: " << processName;
-        cout << "\nRemaining Cycles: " << remainingCycles;
-        cout << "\nState: " << pState;
-        cout << "\nPriority: " << priority;
-        cout << "\nCritical Start: " << criticalStart;
-        cout << "\nCritical Length: " << criticalLength;
-    }
-}; // end of the process class
+    // hot fields, read and written on every dispatch
+    vector<int> remainingCycles; // number of cycles remaining before a process is complete
+    vector<int> criticalStart; // critical section has a start cycle
+    vector<int> criticalLeft; // cycles left in a critical section that was interrupted by io
+    vector<int> inputOutput; // cycle location where the io interrupt is
+    vector<char> pState; // state the process is in [ running, waiting, ready, terminated ]
+    vector<signed char> priority; // priority of the process: 0 = low, 1 = medium, 2 = high
+    vector<long long> readyAt; // simulated time the process last became ready
+    vector<long long> waitingTime; // cycles spent ready but not running
+    vector<const int *> ip; // next program instruction, nullptr for processes without a program
+    vector<int> stepLeft; // cycles left in the CALCULATE at ip, 0 before it starts, or the length of a SLEEP until it begins
+    vector<char> level; // run queue level, 0 is the top, only the feedback scheduler moves processes down
+    vector<int> levelUsed; // cycles run at the current level, the feedback scheduler demotes at its allotment
+    vector<long long> vruntime; // weighted cycles run, the fair share scheduler runs the smallest first
+    vector<int> lastCPU; // CPU the process last ran on, -1 before it has run
+    vector<long long> lastRanAt; // simulated time its last dispatch ended, its cache stays warm for a while after
+
+    // cold fields
+    vector<int> pid; // process ID number
+    vector<int> totalCycles; // total number of cycles it takes to finish a process
+    vector<int> criticalLength; // critical section has a length in cycles
+    vector<int> memory; // memory usage in MB
+    vector<int> nameId; // name of the process, an id in Names
+    vector<long long> arrival; // simulated time the process arrived
+    vector<long long> firstRun; // simulated time the process first got a CPU, -1 before that
+    vector<long long> completion; // simulated time the process terminated, -1 before that
+    vector<int> program; // program the process runs, an id in Programs, -1 for none
+    vector<int> lockId; // simulated lock the critical section takes, -1 for none
+    vector<long long> lockedAt; // simulated time the process got its lock, -1 while it doesn't hold it
+    vector<uint64_t> affinity; // CPUs the process may run on, bit c for CPU c, 0 for any
+
+    // run metrics, counted as the process runs and written out by the metrics export
+    vector<int> switches; // times a CPU switched to this process
+    vector<int> criticalCycles; // cycles run inside the critical section
+    vector<int> ioWaits; // io requests made
+    vector<long long> ioWaitCycles; // cycles from io requests to their completion
+    vector<int> migrations; // dispatches on another CPU than the last one that cost a migration
+
+    int size() {
+        return pid.size();
+    }
+
+    void reserve(int count) {
+        remainingCycles.reserve(count);
+        criticalStart.reserve(count);
+        criticalLeft.reserve(count);
+        inputOutput.reserve(count);
+        pState.reserve(count);
+        priority.reserve(count);
+        pid.reserve(count);
+        totalCycles.reserve(count);
+        criticalLength.reserve(count);
+        memory.reserve(count);
+        nameId.reserve(count);
+        readyAt.reserve(count);
+        waitingTime.reserve(count);
+        arrival.reserve(count);
+        firstRun.reserve(count);
+        completion.reserve(count);
+        ip.reserve(count);
+        level.reserve(count);
+        vruntime.reserve(count);
+        levelUsed.reserve(count);
+        stepLeft.reserve(count);
+        program.reserve(count);
+        lockId.reserve(count);
+        lockedAt.reserve(count);
+        switches.reserve(count);
+        criticalCycles.reserve(count);
+        ioWaits.reserve(count);
+        ioWaitCycles.reserve(count);
+        lastCPU.reserve(count);
+        lastRanAt.reserve(count);
+        affinity.reserve(count);
+        migrations.reserve(count);
+    }
+
+    // drops every process from handle count on, used when a job file turns out to be bad
+    void truncate(int count) {
+        remainingCycles.resize(count);
+        criticalStart.resize(count);
+        criticalLeft.resize(count);
+        inputOutput.resize(count);
+        pState.resize(count);
+        priority.resize(count);
+        pid.resize(count);
+        totalCycles.resize(count);
+        criticalLength.resize(count);
+        memory.resize(count);
+        nameId.resize(count);
+        readyAt.resize(count);
+        waitingTime.resize(count);
+        arrival.resize(count);
+        firstRun.resize(count);
+        completion.resize(count);
+        ip.resize(count);
+        level.resize(count);
+        vruntime.resize(count);
+        levelUsed.resize(count);
+        stepLeft.resize(count);
+        program.resize(count);
+        lockId.resize(count);
+        lockedAt.resize(count);
+        switches.resize(count);
+        criticalCycles.resize(count);
+        ioWaits.resize(count);
+        ioWaitCycles.resize(count);
+        lastCPU.resize(count);
+        lastRanAt.resize(count);
+        affinity.resize(count);
+        migrations.resize(count);
+    }
+
+    // adds count processes with default fields and returns the handle of the first, the caller fills them in
+    int grow(int count) {
+        int first = size();
+        int total = first + count;
+        remainingCycles.resize(total, 0);
+        criticalStart.resize(total, -1);
+        criticalLeft.resize(total, 0);
+        inputOutput.resize(total, -1);
+        pState.resize(total, newP);
+        priority.resize(total, -1);
+        pid.resize(total, -1);
+        totalCycles.resize(total, 0);
+        criticalLength.resize(total, 0);
+        memory.resize(total, 1);
+        nameId.resize(total, 0);
+        readyAt.resize(total, 0);
+        waitingTime.resize(total, 0);
+        arrival.resize(total, 0);
+        firstRun.resize(total, -1);
+        completion.resize(total, -1);
+        ip.resize(total, nullptr);
+        level.resize(total, 0);
+        vruntime.resize(total, 0);
+        levelUsed.resize(total, 0);
+        stepLeft.resize(total, 0);
+        program.resize(total, -1);
+        lockId.resize(total, 0);
+        lockedAt.resize(total, -1);
+        switches.resize(total, 0);
+        criticalCycles.resize(total, 0);
+        ioWaits.resize(total, 0);
+        ioWaitCycles.resize(total, 0);
+        lastCPU.resize(total, -1);
+        lastRanAt.resize(total, -1);
+        affinity.resize(total, 0);
+        migrations.resize(total, 0);
+        return first;
+    }
+
+    // fills slot h with a new process, also used to reuse the slot of a terminated one
+    void set(int h, int p, const JobSpec &job) {
+        set(h, p, job, Names.intern(job.name));
+    }
+
+    // the same with the name already interned, so threads filling different slots never share a lock
+    void set(int h, int p, const JobSpec &job, int name) {
+        remainingCycles[h] = job.cycles; // remainingCycles is always the same as totalCycles at creation
+        criticalStart[h] = job.criticalStart;
+        criticalLeft[h] = 0;
+        inputOutput[h] = job.inputOutput;
+        pState[h] = newP;
+        priority[h] = max(-1, min(job.priority, 127));
+        readyAt[h] = job.arrival;
+        waitingTime[h] = 0;
+        level[h] = 0;
+        levelUsed[h] = 0;
+        vruntime[h] = 0;
+        pid[h] = p;
+        totalCycles[h] = job.cycles;
+        criticalLength[h] = job.criticalLength;
+        memory[h] = 1;
+        nameId[h] = name;
+        arrival[h] = job.arrival;
+        firstRun[h] = -1;
+        completion[h] = -1;
+        switches[h] = 0;
+        criticalCycles[h] = 0;
+        ioWaits[h] = 0;
+        ioWaitCycles[h] = 0;
+        lockId[h] = job.lock;
+        lockedAt[h] = -1;
+        lastCPU[h] = -1;
+        lastRanAt[h] = -1;
+        affinity[h] = job.affinity;
+        migrations[h] = 0;
+        setProgram(h, job.program);
+    }
+
+    // points slot h at the start of a program, the program decides how long the process runs and how
+    // much memory it needs
+    void setProgram(int h, int p) {
+        program[h] = p;
+        ip[h] = nullptr;
+        stepLeft[h] = 0;
+        if (p >= 0) {
+            ip[h] = Programs.start(p);
+            remainingCycles[h] = Programs.cycles[p];
+            totalCycles[h] = Programs.cycles[p];
+            memory[h] = max(1, Programs.ram[p]);
+        }
+    }
+
+    // creates a process and returns its handle
+    int add(int p, const JobSpec &job) {
+        int h = grow(1);
+        set(h, p, job);
+        return h;
+    }
+
+    // saves or restores every column but ip, which points into Programs and is checkpointed as an offset
+    template <class Archive>
+    void checkpoint(Archive &a) {
+        a.io(remainingCycles);
+        a.io(criticalStart);
+        a.io(criticalLeft);
+        a.io(inputOutput);
+        a.io(pState);
+        a.io(priority);
+        a.io(readyAt);
+        a.io(waitingTime);
+        a.io(stepLeft);
+        a.io(level);
+        a.io(levelUsed);
+        a.io(vruntime);
+        a.io(pid);
+        a.io(totalCycles);
+        a.io(criticalLength);
+        a.io(memory);
+        a.io(nameId);
+        a.io(arrival);
+        a.io(firstRun);
+        a.io(completion);
+        a.io(program);
+        a.io(lockId);
+        a.io(lockedAt);
+        a.io(switches);
+        a.io(criticalCycles);
+        a.io(ioWaits);
+        a.io(ioWaitCycles);
+        a.io(lastCPU);
+        a.io(lastRanAt);
+        a.io(affinity);
+        a.io(migrations);
+        if (Archive::reading) {
+            ip.assign(pid.size(), nullptr);
+        }
+    }
+
+    // true if every column has a row for each process and the fields used as indexes are in range, with
+    // levels feedback queue levels and locks simulated locks, checked after a restore
+    bool consistent(int levels, int locks) {
+        size_t n = pid.size();
+        return remainingCycles.size() == n && criticalStart.size() == n && criticalLeft.size() == n && inputOutput.size() == n
+            && pState.size() == n && priority.size() == n && readyAt.size() == n && waitingTime.size() == n && stepLeft.size() == n
+            && level.size() == n && levelUsed.size() == n && vruntime.size() == n && totalCycles.size() == n
+            && criticalLength.size() == n && memory.size() == n && nameId.size() == n && arrival.size() == n
+            && firstRun.size() == n && completion.size() == n && program.size() == n && lockId.size() == n
+            && lockedAt.size() == n && switches.size() == n && criticalCycles.size() == n && ioWaits.size() == n
+            && ioWaitCycles.size() == n && lastCPU.size() == n && lastRanAt.size() == n && affinity.size() == n
+            && migrations.size() == n && n <= (size_t) INT_MAX && inRange(n, levels, locks);
+    }
+
+    // the upper bound of program is checked once the checkpoint's programs are mapped, and any affinity
+    // is valid since the CPUs outside a run are masked off. Cycle counts and times only have to leave
+    // room for a run to count on from them without overflowing.
+    bool inRange(size_t n, int levels, int locks) {
+        const int cycles = INT_MAX / 2;
+        const long long times = maxRestoredTime;
+        auto within = [](long long value, long long limit) { return value >= -limit && value <= limit; };
+        for (size_t h = 0; h < n; h++) {
+            if (pState[h] < newP || pState[h] > sleeping || priority[h] < -1 || level[h] < 0 || level[h] >= levels
+                    || lockId[h] < -1 || lockId[h] >= locks || program[h] < -1 || lastCPU[h] < -1
+                    || !within(remainingCycles[h], cycles) || !within(criticalStart[h], cycles) || !within(criticalLeft[h], cycles)
+                    || !within(inputOutput[h], cycles) || totalCycles[h] < 0 || totalCycles[h] > cycles
+                    || stepLeft[h] < 0 || stepLeft[h] > cycles || levelUsed[h] < 0 || levelUsed[h] > cycles
+                    || readyAt[h] < 0 || readyAt[h] > times || arrival[h] < 0 || arrival[h] > times || !within(lastRanAt[h], times)
+                    || lockedAt[h] < -1 || lockedAt[h] > times || firstRun[h] < -1 || firstRun[h] > times || completion[h] < -1
+                    || completion[h] > times || waitingTime[h] < 0 || waitingTime[h] > times) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void printProcess(int h) {
+        cout << "\nProcess ID: " << pid[h];
+        cout << "\nProcess Name: " << Names.name(nameId[h]);
+        cout << "\nRemaining Cycles: " << remainingCycles[h];
+        cout << "\nState: " << (int) pState[h];
+        cout << "\nPriority: " << (int) priority[h];
+        cout << "\nCritical Start: " << criticalStart[h];
+        cout << "\nCritical Length: " << criticalLength[h];
+        if (program[h] >= 0) {
+            cout << "\nProgram: " << Names.name(Programs.pathId[program[h]]) << " (" << memory[h] << " MB)";
+        }
+    }
+}; // end of the process table class
+
+
+
+
+// Trace logging for the scheduler hot path. Each thread writes small binary records into its own
+// single producer ring buffer without taking a lock, and a background writer thread drains the
+// buffers and formats the records into text. Records above the current level are never written,
+// so logQuiet costs one compare per event. A full buffer drops records instead of stalling the CPU.
+enum logLevel { logQuiet, logInfo, logDebug };
+// logQuiet: nothing is printed while the schedulers run
+// logInfo: critical sections, io, program output and finishing processes
+// logDebug: every dispatch including memory hits and misses
+enum traceEvent { traceMemoryHit, traceMemoryMiss, traceMemoryAdd, traceMemoryFull, traceMemoryRemove,
+    traceMemoryEvict, traceRunning, traceCritical, traceIOInterrupt, traceIOComplete, traceFinish, traceArrival, traceYield, traceOut,
+    traceLockWait, traceLockHandoff, traceMemoryFault, traceSleep, traceWake };
+
+struct LogRecord {
+    int event; // traceEvent
+    int pid; // process the event happened to
+    int name; // its name id in Names
+    int value; // event specific value, remaining cycles for traceRunning
+};
+
+class LogBuffer {
+    public:
+        static const unsigned capacity = 1 << 16; // records, must be a power of two
+        LogRecord records[capacity];
+        atomic<unsigned> head{0}; // next record the writer reads
+        atomic<unsigned> tail{0}; // next record the owning thread writes
+        atomic<bool> inUse{false}; // a live thread owns this buffer
+        atomic<long long> dropped{0}; // records lost because the buffer was full
+
+        void push(const LogRecord &record) {
+            unsigned t = tail.load(memory_order_relaxed);
+            if (t - head.load(memory_order_acquire) == capacity) {
+                dropped.fetch_add(1, memory_order_relaxed);
+                return;
+            }
+            records[t & (capacity - 1)] = record;
+            tail.store(t + 1, memory_order_release);
+        }
+};
+
+class TraceLog {
+    public:
+        atomic<int> level{logDebug};
+        vector<unique_ptr<LogBuffer>> buffers; // one per thread that has logged, reused after it ends
+        mutex registryLock; // guards buffers, never taken on the hot path
+        ostream *out = &cout;
+        thread writer;
+        atomic<bool> stopping{false};
+        long long reportedDrops = 0;
+
+        TraceLog() {
+            writer = thread(&TraceLog::writeLoop, this);
+        }
+
+        ~TraceLog() {
+            stopping = true;
+            writer.join();
+        }
+
+        // logs an event for the process with handle h in table
+        void record(int recordLevel, int event, const ProcessTable &table, int h, int value = 0) {
+            if (recordLevel > level.load(memory_order_relaxed)) {
+                return;
+            }
+            buffer()->push(LogRecord{event, table.pid[h], table.nameId[h], value});
+        }
+
+        // waits until the writer has printed everything logged so far
+        void flush() {
+            while (!drained()) {
+                this_thread::sleep_for(chrono::microseconds(100));
+            }
+            long long dropped = 0;
+            registryLock.lock(); // simulations running side by side can flush at the same time
+            for (auto &b : buffers) {
+                dropped += b->dropped;
+            }
+            if (dropped > reportedDrops) {
+                *out << "\n(" << dropped - reportedDrops << " trace records dropped, try log info or log quiet)";
+                reportedDrops = dropped;
+            }
+            out->flush();
+            registryLock.unlock();
+        }
+
+    private:
+        struct BufferHandle { // gives the buffer back when its thread ends
+            LogBuffer *buffer = nullptr;
+            ~BufferHandle() {
+                if (buffer != nullptr) {
+                    buffer->inUse = false;
+                }
+            }
+        };
+
+        LogBuffer *buffer() {
+            static thread_local BufferHandle handle;
+            if (handle.buffer == nullptr) {
+                registryLock.lock();
+                for (auto &b : buffers) {
+                    bool freeBuffer = false;
+                    if (b->inUse.compare_exchange_strong(freeBuffer, true)) {
+                        handle.buffer = b.get();
+                        break;
+                    }
+                }
+                if (handle.buffer == nullptr) {
+                    buffers.push_back(unique_ptr<LogBuffer>(new LogBuffer()));
+                    handle.buffer = buffers.back().get();
+                    handle.buffer->inUse = true;
+                }
+                registryLock.unlock();
+            }
+            return handle.buffer;
+        }
+
+        bool drained() {
+            registryLock.lock();
+            bool empty = true;
+            for (auto &b : buffers) {
+                if (b->head.load(memory_order_acquire) != b->tail.load(memory_order_acquire)) {
+                    empty = false;
+                }
+            }
+            registryLock.unlock();
+            return empty;
+        }
+
+        void format(ostringstream &text, const LogRecord &r) {
+            const string &name = Names.name(r.name);
+            switch (r.event) {
+                case traceMemoryHit: text << "\nProcess " << name << " is already in memory."; break;
+                case traceMemoryMiss: text << "\nProcess " << name << " is not in memory."; break;
+                case traceMemoryAdd: text << "\nAdding Process " << name << " to the memory."; break;
+                case traceMemoryFull: text << "\nMemory full. Adding Process " << name << " to the memory."; break;
+                case traceMemoryRemove: text << "\nRemoving Process " << name << " from the memory."; break;
+                case traceMemoryEvict: text << "\nEvicting Process " << name << " from the memory."; break;
+                case traceRunning: text << "\nRunning " << name << " pid: " << r.pid << " has " << r.value << " cycles left before it completes."; break;
+                case traceCritical: text << "\nCritical Section Started for process " << name << " pid: " << r.pid; break;
+                case traceIOInterrupt: text << "\nIO INTERUPT in process: " << name << " pid: " << r.pid; break;
+                case traceIOComplete: text << "\nIO complete for process: " << name << " pid: " << r.pid; break;
+                case traceFinish: text << "\nFinishing process " << name << " pid: " << r.pid; break;
+                case traceArrival: text << "\nProcess " << name << " pid: " << r.pid << " arrived at cycle " << r.value; break;
+                case traceYield: text << "\nProcess " << name << " pid: " << r.pid << " yielded the CPU"; break;
+                case traceOut: text << "\nOUT " << name << " pid: " << r.pid << ": " << Names.name(r.value); break;
+                case traceLockWait: text << "\nProcess " << name << " pid: " << r.pid << " waits for lock " << r.value; break;
+                case traceLockHandoff: text << "\nLock " << r.value << " handed to process " << name << " pid: " << r.pid; break;
+                case traceMemoryFault: text << "\nPage fault on page " << r.value << " of process " << name << " pid: " << r.pid; break;
+                case traceSleep: text << "\nProcess " << name << " pid: " << r.pid << " sleeps for " << r.value << " cycles"; break;
+                case traceWake: text << "\nProcess " << name << " pid: " << r.pid << " woke up"; break;
+            }
+        }
+
+        // formats every record waiting in the buffers, returns false if there was nothing to do
+        bool drainOnce() {
+            ostringstream text;
+            bool any = false;
+            vector<pair<LogBuffer *, unsigned>> consumed; // heads move only once the text is written so flush can't overtake it
+            registryLock.lock();
+            Names.nameLock.lock();
+            for (auto &b : buffers) {
+                unsigned h = b->head.load(memory_order_relaxed);
+                unsigned t = b->tail.load(memory_order_acquire);
+                if (h == t) {
+                    continue;
+                }
+                for (; h != t; h++) {
+                    format(text, b->records[h & (LogBuffer::capacity - 1)]);
+                }
+                consumed.push_back(make_pair(b.get(), t));
+                any = true;
+            }
+            Names.nameLock.unlock();
+            registryLock.unlock();
+            if (any) {
+                string s = text.str();
+                out->write(s.data(), s.size());
+                out->flush();
+            }
+            for (auto &c : consumed) {
+                c.first->head.store(c.second, memory_order_release);
+            }
+            return any;
+        }
+
+        void writeLoop() {
+            while (!stopping) {
+                if (!drainOnce()) {
+                    this_thread::sleep_for(chrono::microseconds(200));
+                }
+            }
+            drainOnce();
+            out->flush();
+        }
+};
+
+TraceLog Trace; // scheduler trace output, see the log command
+
+// Schedule traces. While a run records one, every CPU writes what it did as 16 byte records stamped
+// with its simulated clock: arrivals, dispatches and how each one ended, critical sections and the
+// pages a dispatch read in or evicted. Each CPU fills its own preallocated block that only its thread
+// writes, so a record is a couple of stores, and a full block is handed to a writer thread that
+// puts it in the file while the CPU carries on with a spare one. The records of one CPU are in its
+// clock order. --replay reads the file back into Gantt chart rows and
+// the run's scheduling metrics without running the simulation again.
+enum scheduleEvent { scheduleArrival, scheduleDispatch, schedulePreempt, scheduleIO, scheduleLockWait, scheduleTerminate,
+    scheduleCriticalEnter, scheduleCriticalExit, schedulePagesIn, schedulePagesOut, scheduleSleep };
+
+struct ScheduleRecord {
+    uint64_t stamp; // simulated cycle << 8 | scheduleEvent
+    int32_t pid;
+    // arrival: name id in the trace's names, dispatch: cycles spent waiting in a run queue since it was last ready,
+    // preempt, io, lock wait, terminate and sleep end the dispatch: cycles run on the CPU, critical enter: lock id,
+    // critical exit: cycles left in the critical section, pages in and out: page count
+    int32_t value;
+};
+
+const char scheduleMagic[8] = { 'O', 'P', 'S', 'I', 'M', 'S', 'C', 'H' };
+const uint32_t scheduleVersion = 1;
+
+struct ScheduleHeader {
+    char magic[8]; // scheduleMagic
+    uint32_t version; // scheduleVersion
+    uint32_t cpus;
+};
+
+// A file is the header followed by blocks. The last block is the names: count lengths and then the names back to back.
+struct ScheduleBlock {
+    static const uint32_t names = UINT32_MAX; // cpu of the names block
+    uint32_t cpu;
+    uint32_t count; // records in the block
+};
+
+class ScheduleTrace {
+    public:
+        static const int blockRecords = 1 << 14;
+        bool recording = false;
+
+        // starts a trace of a run on cpus CPUs, returns false if the file can't be written
+        bool open(const string &path, int cpus) {
+            file.open(path, ios::binary | ios::trunc);
+            if (!file.is_open()) {
+                cerr << "\nCould not write " << path << "\n";
+                return false;
+            }
+            ScheduleHeader header;
+            memcpy(header.magic, scheduleMagic, sizeof(header.magic));
+            header.version = scheduleVersion;
+            header.cpus = cpus;
+            file.write((const char *) &header, sizeof(header));
+            blocks.clear();
+            current.clear();
+            spare.clear();
+            for (int i = 0; i < 2 * cpus + 2; i++) { // each CPU fills one while the writer has the others
+                blocks.push_back(unique_ptr<Block>(new Block()));
+                spare.push_back(blocks.back().get());
+            }
+            for (int cpu = 0; cpu < cpus; cpu++) {
+                current.push_back(takeSpare(cpu));
+            }
+            closing = false;
+            writer = thread(&ScheduleTrace::writeLoop, this);
+            recording = true;
+            return true;
+        }
+
+        // only called by the thread running cpu
+        void record(int cpu, long long cycle, int event, int pid, int value) {
+            Block &b = *current[cpu];
+            b.records[b.count++] = ScheduleRecord{(uint64_t) cycle << 8 | event, pid, value};
+            if (b.count == blockRecords) {
+                queueLock.lock();
+                full.push_back(current[cpu]);
+                queueLock.unlock();
+                changed.notify_all();
+                current[cpu] = takeSpare(cpu);
+            }
+        }
+
+        // writes what is left in the buffers and the names, once every CPU has stopped
+        bool close() {
+            queueLock.lock();
+            for (Block *b : current) {
+                full.push_back(b);
+            }
+            closing = true;
+            queueLock.unlock();
+            changed.notify_all();
+            writer.join();
+            vector<uint32_t> lengths;
+            string names;
+            Names.nameLock.lock();
+            for (int id = 0; id < Names.size(); id++) {
+                lengths.push_back(Names.name(id).size());
+                names += Names.name(id);
+            }
+            Names.nameLock.unlock();
+            ScheduleBlock block{ScheduleBlock::names, (uint32_t) lengths.size()};
+            file.write((const char *) &block, sizeof(block));
+            file.write((const char *) lengths.data(), lengths.size() * sizeof(uint32_t));
+            file.write(names.data(), names.size());
+            bool written = file.good();
+            file.close();
+            blocks.clear();
+            recording = false;
+            return written;
+        }
+
+    private:
+        struct Block {
+            int cpu = 0;
+            int count = 0;
+            ScheduleRecord records[blockRecords];
+        };
+        vector<unique_ptr<Block>> blocks; // every block, allocated when the trace opens
+        vector<Block *> current; // the block each CPU is filling
+        vector<Block *> spare; // empty blocks
+        deque<Block *> full; // blocks waiting for the writer, in the order they filled up
+        mutex queueLock; // guards spare and full, taken once per block
+        condition_variable changed;
+        bool closing = false;
+        thread writer; // writes the full blocks so a CPU never waits on the file unless the writer falls behind
+        ofstream file;
+
+        Block *takeSpare(int cpu) {
+            unique_lock<mutex> lock(queueLock);
+            changed.wait(lock, [this] { return !spare.empty(); });
+            Block *b = spare.back();
+            spare.pop_back();
+            b->cpu = cpu;
+            b->count = 0;
+            return b;
+        }
+
+        void writeLoop() {
+            unique_lock<mutex> lock(queueLock);
+            while (true) {
+                changed.wait(lock, [this] { return !full.empty() || closing; });
+                if (full.empty()) {
+                    return;
+                }
+                Block *b = full.front();
+                full.pop_front();
+                lock.unlock();
+                if (b->count > 0) {
+                    ScheduleBlock block{(uint32_t) b->cpu, (uint32_t) b->count};
+                    file.write((const char *) &block, sizeof(block));
+                    file.write((const char *) b->records, b->count * sizeof(ScheduleRecord));
+                }
+                lock.lock();
+                spare.push_back(b);
+                changed.notify_all();
+            }
+        }
+};
+
+
+// A set associative TLB for one CPU. Entries are tagged with the process handle as well as the page
+// so a context switch doesn't flush it, instead a page's entries are shot down when it leaves memory.
+// Each set replaces its ways round robin, which is cheap and close enough to LRU for 4 ways.
+struct Tlb {
+    static const int sets = 16; // must be a power of two
+    static const int ways = 4;
+    int process[sets * ways]; // handle of each entry, -1 when the entry is empty
+    int page[sets * ways];
+    int frame[sets * ways];
+    unsigned char nextWay[sets]; // way the next insert into a set replaces
+
+    Tlb() {
+        fill(process, process + sets * ways, -1);
+        fill(nextWay, nextWay + sets, 0);
+    }
+
+    static int firstWay(int h, int p) {
+        return ((unsigned) (h * 31 + p) & (sets - 1)) * ways;
+    }
+
+    // frame holding page p of process h, -1 on a miss
+    int lookup(int h, int p) {
+        int first = firstWay(h, p);
+        for (int i = first; i < first + ways; i++) {
+            if (process[i] == h && page[i] == p) {
+                return frame[i];
+            }
+        }
+        return -1;
+    }
+
+    void insert(int h, int p, int f) {
+        int first = firstWay(h, p);
+        int set = first / ways;
+        int i = first + nextWay[set];
+        nextWay[set] = (nextWay[set] + 1) % ways;
+        process[i] = h;
+        page[i] = p;
+        frame[i] = f;
+    }
+
+    void invalidate(int h, int p) {
+        int first = firstWay(h, p);
+        for (int i = first; i < first + ways; i++) {
+            if (process[i] == h && page[i] == p) {
+                process[i] = -1;
+            }
+        }
+    }
+};
+
+// Memory management class
+// Memory is paged. A process' RAM is split into pages of frameSize MB, its page table is sized from
+// the RAM it declares and a page only takes a frame once the process uses it, or when the process is
+// swapped back in together with its working set. The page tables of every process share one flat
+// array and a handle's PageTable says where its table starts, so a lookup is two array reads.
+// Page 0 is kept in the PageTable itself, which saves single page processes the second read.
+// Every cycle a process runs is a memory access: it works on one page for cyclesPerPage cycles and
+// then moves to its next page, wrapping around at the end of its table. The accesses go through the
+// CPU's TLB first and only a TLB miss walks the page table.
+// Resident pages are kept in a linked list of frames in load order (FIFO) or use order (LRU) so the
+// victim is always at the head. CLOCK sweeps a hand over the frames instead, giving each referenced
+// page a second chance, and WS does the same but also passes over pages in their owner's working set
+// so the pages a process is still using go last.
+enum replacementPolicy { replaceFIFO, replaceLRU, replaceCLOCK, replaceWS };
+
+class Memory {
+    public:
+        vector<int> frameOwner; // process handle of the page in each frame, -1 when the frame is free
+        vector<int> framePage; // page of that process the frame holds
+        vector<int> freeFrames; // frames not holding a page
+        vector<int> prev, next; // frames of resident pages in FIFO or LRU order, -1 ends the list
+        vector<char> referenced; // CLOCK and WS reference bit of each frame
+        int head = -1; // next frame to evict for FIFO and LRU
+        int tail = -1; // most recently loaded (FIFO) or used (LRU) frame
+        int hand = 0; // CLOCK hand
+        int policy = replaceFIFO;
+        int frameSize = 256; // MB per frame and page
+        int memoryUsage = 0; // keeps track of the overall memory usage in frames
+        int cyclesPerPage = 16; // cycles a process runs on one page before it moves to the next
+        int workingSetWindow = 200; // a page is in the working set if its owner used it in this many of its own cycles
+        int faultCycles = 0; // cycles a CPU stalls for each page fault
+        long long hits = 0; // dispatches that found the process in memory
+        long long misses = 0; // dispatches that had to swap it in
+        long long evictions = 0; // pages removed to make room for another one
+        long long accesses = 0; // simulated memory accesses, one per cycle run
+        long long tlbMisses = 0; // accesses that had to walk a page table
+        long long pageFaults = 0; // accesses to a page that was not in memory
+
+        struct Page {
+            int frame; // frame holding the page, -1 when it is not in memory
+            int used; // the owner's executed cycles when it last used the page
+        };
+        struct PageTable {
+            Page first; // page 0 lives in the table so most processes, which have one page, need no second lookup
+            int base = 0; // where the rest of the table starts in pages
+            int count = 0; // pages in the table, 0 until the process first uses memory
+            int capacity = 0; // pages reserved at base, kept when a streamed slot is reused
+            int resident = 0; // pages in memory
+            int executed = 0; // the owner's executed cycles after its last dispatch, what WS judges its pages against
+        };
+        vector<PageTable> tables; // page table of each handle
+        vector<Page> pages; // pages 1 and up of every table
+        vector<Tlb> tlbs; // one per CPU
+        ProcessTable &processes; // the processes whose handles the frames hold
+
+        Memory(ProcessTable &table, int frameCount = 4, int replacement = replaceFIFO) : processes(table) {
+                resize(frameCount, replacement);
+        }
+
+        // empties the memory and sets a new frame count, replacement policy and frame size
+        void resize(int frameCount, int replacement, int megabytes = 0) {
+            frameCount = max(1, frameCount);
+            if (megabytes > 0) {
+                frameSize = megabytes;
+            }
+            frameOwner.assign(frameCount, -1);
+            framePage.assign(frameCount, -1);
+            freeFrames.clear();
+            for (int i = frameCount - 1; i >= 0; i--) { // frame 0 is handed out first
+                freeFrames.push_back(i);
+            }
+            prev.assign(frameCount, -1);
+            next.assign(frameCount, -1);
+            referenced.assign(frameCount, 0);
+            head = -1;
+            tail = -1;
+            hand = 0;
+            policy = replacement;
+            memoryUsage = 0;
+            hits = 0;
+            misses = 0;
+            evictions = 0;
+            accesses = 0;
+            tlbMisses = 0;
+            pageFaults = 0;
+            tables.clear(); // the page size may have changed so every table is set up again
+            pages.clear();
+            useCPUs(max(1, (int) tlbs.size()));
+        }
+
+        // gives every CPU an empty TLB
+        void useCPUs(int cpus) {
+            tlbs.assign(cpus, Tlb());
+        }
+
+        // page table of process h, set up on its first use
+        PageTable &tableOf(int h) {
+            if (h >= (int) tables.size()) {
+                tables.resize(max(h + 1, processes.size()));
+            }
+            PageTable &table = tables[h];
+            if (table.count == 0) {
+                int needed = max(1, (processes.memory[h] + frameSize - 1) / frameSize);
+                if (needed > table.capacity) {
+                    table.base = pages.size();
+                    table.capacity = needed;
+                    pages.resize(pages.size() + needed - 1);
+                }
+                table.first = Page{-1, INT_MIN};
+                fill(pages.begin() + table.base, pages.begin() + table.base + needed - 1, Page{-1, INT_MIN});
+                table.count = needed;
+            }
+            return table;
+        }
+
+        // swaps process h in with the page it runs at its executed cycle at and the rest of its working set
+        void addProcess(int h, int at = 0) {
+            PageTable &table = tableOf(h);
+            if (table.resident > 0) {
+                return;
+            }
+            int current = pageAt(table, at);
+            long long before = evictions;
+            for (int i = 0; i < table.count && table.resident < (int) frameOwner.size(); i++) {
+                int page = (current + i) % table.count;
+                if (page == current || inWorkingSet(h, page)) {
+                    loadPage(h, page);
+                }
+            }
+            Trace.record(logDebug, evictions == before ? traceMemoryAdd : traceMemoryFull, processes, h);
+        }
+
+        // whether any of process h is in memory, a hit also uses the page it runs at its executed cycle at
+        bool checkMemory(int h, int at = 0) {
+            bool inMemory = h < (int) tables.size() && tables[h].resident > 0;
+            if (inMemory) {
+                hits++;
+                int frame = pageOf(tables[h], pageAt(tables[h], at)).frame;
+                if (frame >= 0) {
+                    touch(frame);
+                }
+            } else {
+                misses++;
+            }
+            Trace.record(logDebug, inMemory ? traceMemoryHit : traceMemoryMiss, processes, h);
+            return inMemory;
+        }
+
+        // one dispatch of process h on cpu: swaps the process in if none of it is in memory, then makes
+        // the accesses of the cycles cycles it ran from its executed cycle from. Returns the page faults.
+        int dispatch(int cpu, int h, int from, int cycles) {
+            tableOf(h).executed = from + cycles; // set under the memory lock, the process table may be changing on another CPU
+            if (!checkMemory(h, from)) {
+                addProcess(h, from);
+            }
+            return access(cpu, h, from, cycles);
+        }
+
+        // runs the memory accesses of cycles cycles of process h from its executed cycle from on cpu,
+        // faulting in the pages that are not resident, and returns the number of page faults
+        int access(int cpu, int h, int from, int cycles) {
+            PageTable &table = tableOf(h);
+            Tlb &tlb = tlbs[cpu];
+            int faults = 0;
+            for (int at = from, end = from + cycles; at < end;) {
+                int page = pageAt(table, at);
+                int until = table.count == 1 ? end : min(end, (at / cyclesPerPage + 1) * cyclesPerPage); // the accesses up to here stay on the page
+                int frame = tlb.lookup(h, page);
+                if (frame < 0) { // only the first access to the page misses, the rest find the entry it left
+                    tlbMisses++;
+                    frame = pageOf(table, page).frame;
+                    if (frame < 0) {
+                        faults++;
+                        Trace.record(logDebug, traceMemoryFault, processes, h, page);
+                        frame = loadPage(h, page);
+                    }
+                    tlb.insert(h, page, frame);
+                }
+                touch(frame);
+                pageOf(table, page).used = until;
+                accesses += until - at;
+                at = until;
+            }
+            pageFaults += faults;
+            return faults;
+        }
 
+        // frees the pages of a terminated process and its page table
+        void removeProcess(int h) {
+            if (h >= (int) tables.size() || tables[h].count == 0) {
+                return;
+            }
+            PageTable &table = tables[h];
+            if (table.resident > 0) { // if the process is found in memory we remove it
+                for (int page = 0; page < table.count; page++) {
+                    if (pageOf(table, page).frame >= 0) {
+                        release(pageOf(table, page).frame);
+                    }
+                }
+                Trace.record(logDebug, traceMemoryRemove, processes, h);
+            }
+            table.count = 0; // the slot's next process gets a fresh table
+        }
+
+        template <class Archive>
+        void checkpoint(Archive &a) {
+            a.io(frameOwner);
+            a.io(framePage);
+            a.io(freeFrames);
+            a.io(prev);
+            a.io(next);
+            a.io(referenced);
+            a.io(head);
+            a.io(tail);
+            a.io(hand);
+            a.io(policy);
+            a.io(frameSize);
+            a.io(memoryUsage);
+            a.io(cyclesPerPage);
+            a.io(workingSetWindow);
+            a.io(faultCycles);
+            a.io(hits);
+            a.io(misses);
+            a.io(evictions);
+            a.io(accesses);
+            a.io(tlbMisses);
+            a.io(pageFaults);
+            a.io(tables);
+            a.io(pages);
+            a.io(tlbs);
+        }
+
+        // true if the frames, the eviction list, the free frames, the page tables and the TLBs all agree and
+        // every resident page belongs to one of processCount processes, checked after a restore
+        bool consistent(int processCount) {
+            int frames = frameOwner.size();
+            if (frames == 0 || framePage.size() != (size_t) frames || prev.size() != (size_t) frames || next.size() != (size_t) frames
+                    || referenced.size() != (size_t) frames || policy < replaceFIFO || policy > replaceWS || frameSize < 1
+                    || cyclesPerPage < 1 || workingSetWindow < 1 || hand < 0 || hand >= frames || head < -1 || head >= frames || tail < -1 || tail >= frames) {
+                return false;
+            }
+            for (PageTable &table : tables) {
+                if (table.count < 0 || table.count > table.capacity || table.base < 0 || table.resident < 0 || table.executed < 0
+                        || (size_t) table.base + max(0, table.capacity - 1) > pages.size()) {
+                    return false;
+                }
+            }
+            int used = 0; // frames holding a page
+            for (int f = 0; f < frames; f++) {
+                int h = frameOwner[f];
+                if (h < -1 || h >= min((int) tables.size(), processCount) || prev[f] < -1 || prev[f] >= frames || next[f] < -1 || next[f] >= frames) {
+                    return false;
+                }
+                if (h >= 0) { // the page table entry points back at the frame
+                    if (framePage[f] < 0 || framePage[f] >= tables[h].count || pageOf(tables[h], framePage[f]).frame != f) {
+                        return false;
+                    }
+                    used++;
+                }
+            }
+            vector<char> free(frames, 0);
+            for (int frame : freeFrames) {
+                if (frame < 0 || frame >= frames || frameOwner[frame] != -1 || free[frame]) {
+                    return false;
+                }
+                free[frame] = 1;
+            }
+            if ((int) freeFrames.size() != frames - used || memoryUsage != used) {
+                return false;
+            }
+            for (size_t h = 0; h < tables.size(); h++) { // every resident page is in the frame that says it holds it
+                int resident = 0;
+                for (int page = 0; page < tables[h].count; page++) {
+                    int frame = pageOf(tables[h], page).frame;
+                    if (frame < -1 || frame >= frames || (frame >= 0 && (frameOwner[frame] != (int) h || framePage[frame] != page))) {
+                        return false;
+                    }
+                    resident += frame >= 0;
+                }
+                if (resident != tables[h].resident) {
+                    return false;
+                }
+            }
+            int listed = 0; // FIFO and LRU evict from the head of the list, which has to hold every resident frame once
+            for (int f = head, before = -1; f >= 0; before = f, f = next[f]) {
+                if (++listed > used || frameOwner[f] < 0 || prev[f] != before || (next[f] < 0 && tail != f)) {
+                    return false;
+                }
+            }
+            if (listed != used || (used == 0 && tail != -1)) {
+                return false;
+            }
+            for (Tlb &tlb : tlbs) {
+                for (int set = 0; set < Tlb::sets; set++) {
+                    if (tlb.nextWay[set] >= Tlb::ways) {
+                        return false;
+                    }
+                }
+                for (int i = 0; i < Tlb::sets * Tlb::ways; i++) { // an entry is shot down when its page leaves its frame
+                    int frame = tlb.frame[i];
+                    if (tlb.process[i] >= 0 && (frame < 0 || frame >= frames || frameOwner[frame] != tlb.process[i]
+                            || framePage[frame] != tlb.page[i])) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        void printStats() {
+            const char *names[] = { "FIFO", "LRU", "CLOCK", "WS" };
+            cout << "\nMemory: " << memoryUsage << "/" << frameOwner.size() << " frames of " << frameSize << " MB used (" << names[policy] << ")";
+            cout << " hits: " << hits << " misses: " << misses << " evictions: " << evictions;
+            cout << "\nPaging: " << accesses << " accesses, " << tlbMisses << " TLB misses (" << Tlb::sets << " sets x " << Tlb::ways
+                 << " ways per CPU), " << pageFaults << " page faults costing " << faultCycles << " cycles each";
+        }
+
+    private:
+        Page &pageOf(PageTable &table, int page) {
+            return page == 0 ? table.first : pages[table.base + page - 1];
+        }
+
+        // page a process accesses at its executed cycle at
+        int pageAt(PageTable &table, int at) {
+            return table.count == 1 ? 0 : at / cyclesPerPage % table.count;
+        }
+
+        bool inWorkingSet(int h, int page) {
+            return pageOf(tables[h], page).used > tables[h].executed - workingSetWindow;
+        }
+
+        // brings page of process h into a frame, evicting another page when memory is full
+        int loadPage(int h, int page) {
+            if (freeFrames.empty()) {
+                int frame = victim();
+                Trace.record(logDebug, traceMemoryEvict, processes, frameOwner[frame]);
+                release(frame);
+                evictions++;
+            }
+            int frame = freeFrames.back();
+            freeFrames.pop_back();
+            frameOwner[frame] = h; // the momory now holds the page
+            framePage[frame] = page;
+            pageOf(tables[h], page).frame = frame;
+            tables[h].resident++;
+            append(frame);
+            referenced[frame] = 1;
+            memoryUsage++; // incrememnt memory usage
+            return frame;
+        }
+
+        int victim() { // only called when every frame holds a page
+            if (policy == replaceFIFO || policy == replaceLRU) {
+                return head;
+            }
+            int frames = frameOwner.size();
+            for (int swept = 0;; swept++) {
+                int frame = hand;
+                hand = (hand + 1) % frames;
+                if (referenced[frame]) {
+                    referenced[frame] = 0; // second chance for recently used pages
+                } else if (policy != replaceWS || swept >= 2 * frames || !inWorkingSet(frameOwner[frame], framePage[frame])) {
+                    return frame; // WS falls back to CLOCK when every page is in a working set
+                }
+            }
+        }
+
+        void touch(int frame) {
+            if (policy == replaceLRU) { // a used page moves to the back of the eviction order
+                unlink(frame);
+                append(frame);
+            }
+            referenced[frame] = 1;
+        }
+
+        // frees a frame and shoots down the TLB entries that point at it
+        void release(int frame) {
+            int h = frameOwner[frame];
+            int page = framePage[frame];
+            for (Tlb &tlb : tlbs) {
+                tlb.invalidate(h, page);
+            }
+            pageOf(tables[h], page).frame = -1;
+            tables[h].resident--;
+            unlink(frame);
+            referenced[frame] = 0;
+            frameOwner[frame] = -1;
+            framePage[frame] = -1;
+            freeFrames.push_back(frame);
+            memoryUsage--; // decrememnt memory usage
+        }
+
+        void append(int frame) {
+            prev[frame] = tail;
+            next[frame] = -1;
+            if (tail >= 0) {
+                next[tail] = frame;
+            } else {
+                head = frame;
+            }
+            tail = frame;
+        }
+
+        void unlink(int frame) {
+            if (prev[frame] >= 0) {
+                next[prev[frame]] = next[frame];
+            } else {
+                head = next[frame];
+            }
+            if (next[frame] >= 0) {
+                prev[next[frame]] = prev[frame];
+            } else {
+                tail = prev[frame];
+            }
+            prev[frame] = -1;
+            next[frame] = -1;
+        }
+};
+
+// replacement policy called name on the command line, -1 if there is none
+int replacementNamed(const string &name) {
+    const char *names[] = { "fifo", "lru", "clock", "ws" };
+    for (int policy = replaceFIFO; policy <= replaceWS; policy++) {
+        if (name == names[policy]) {
+            return policy;
+        }
+    }
+    return -1;
+}
+
+// Fifo in a ring buffer. It doubles when it fills up and never shrinks, so once it has held the most
+// it ever will, pushing and popping move no memory. A deque frees and allocates its chunks over and
+// over as a round robin queue churns through them.
+template <class T>
+class RingQueue {
+    public:
+        vector<T> slots; // the size is always 0 or a power of two
+        size_t head = 0; // slot of the front
+        size_t count = 0;
+
+        bool empty() const {
+            return count == 0;
+        }
+
+        size_t size() const {
+            return count;
+        }
+
+        T &front() {
+            return slots[head];
+        }
+
+        // i places behind the front
+        T &operator[](size_t i) {
+            return slots[(head + i) & (slots.size() - 1)];
+        }
+
+        void push_back(const T &value) {
+            if (count == slots.size()) {
+                grow(max((size_t) 16, 2 * slots.size()));
+            }
+            slots[(head + count) & (slots.size() - 1)] = value;
+            count++;
+        }
+
+        void pop_front() {
+            head = (head + 1) & (slots.size() - 1);
+            count--;
+        }
+
+        void clear() {
+            head = 0;
+            count = 0;
+        }
+
+        void reserve(size_t capacity) {
+            size_t size = 16;
+            while (size < capacity) {
+                size *= 2;
+            }
+            if (size > slots.size()) {
+                grow(size);
+            }
+        }
+
+        void grow(size_t size) {
+            vector<T> bigger(size);
+            for (size_t i = 0; i < count; i++) {
+                bigger[i] = (*this)[i];
+            }
+            slots.swap(bigger);
+            head = 0;
+        }
+};
+
+// Queue disciplines. A discipline decides the order a CPU's queued processes run in; it is only
+// called with the run queue's lock held and is picked at compile time by the scheduling policy.
+
+// One fifo per level and a process goes into the one for its level in the process table. A bitmap
+// of the levels that hold processes finds the highest one with a single bit scan. Policies that
+// don't move processes between levels keep everything on level 0, which makes this a plain fifo.
+const int runLevels = 5; // levels of the multilevel feedback queue
+
+class LevelQueue {
+    public:
+        RingQueue<int> levels[runLevels]; // process handles, level 0 runs first
+        unsigned occupied = 0; // bit i is set while levels[i] is not empty
+        ProcessTable &processes;
+
+        LevelQueue(ProcessTable &table) : processes(table) {}
+
+        // every process starts on level 0
+        void reserve(int count) {
+            levels[0].reserve(count);
+        }
+
+        void push(int h) {
+            int l = processes.level[h];
+            levels[l].push_back(h);
+            occupied |= 1u << l;
+        }
+
+        bool take(int &h) {
+            if (occupied == 0) {
+                return false;
+            }
+            int l = __builtin_ctz(occupied); // highest level with a process
+            h = levels[l].front();
+            levels[l].pop_front();
+            if (levels[l].empty()) {
+                occupied &= ~(1u << l);
+            }
+            return true;
+        }
+
+        // the process take would return, false when the queue is empty
+        bool peek(int &h) {
+            if (occupied == 0) {
+                return false;
+            }
+            h = levels[__builtin_ctz(occupied)].front();
+            return true;
+        }
+
+        int size() {
+            size_t count = 0;
+            for (int l = 0; l < runLevels; l++) {
+                count += levels[l].size();
+            }
+            return count;
+        }
+
+        // moves every queued process up to level 0 behind the ones already there, so nothing starves
+        void boost() {
+            for (int l = 1; l < runLevels; l++) {
+                for (size_t i = 0; i < levels[l].size(); i++) {
+                    int h = levels[l][i];
+                    processes.level[h] = 0;
+                    processes.levelUsed[h] = 0;
+                    levels[0].push_back(h);
+                }
+                levels[l].clear();
+            }
+            if (occupied != 0) {
+                occupied = 1;
+            }
+        }
+};
+
+// Binary heap on virtual runtime, the process with the least runs first. A handle is queued once, so
+// no two entries are equal and the order is the same as a sorted set's without a node per process.
+class VruntimeQueue {
+    public:
+        vector<pair<long long, int>> byVruntime; // heap of (vruntime, handle) of the queued processes
+        long long minVruntime = 0; // vruntime of the last process taken, never goes down
+        ProcessTable &processes;
+
+        VruntimeQueue(ProcessTable &table) : processes(table) {}
+
+        void push(int h) {
+            // a process coming back from io or just arriving can't have fallen behind the others,
+            // or it would hold the CPU until it caught up
+            long long &v = processes.vruntime[h];
+            v = max(v, minVruntime);
+            byVruntime.push_back(make_pair(v, h));
+            push_heap(byVruntime.begin(), byVruntime.end(), greater<pair<long long, int>>());
+        }
+
+        bool take(int &h) {
+            if (byVruntime.empty()) {
+                return false;
+            }
+            pop_heap(byVruntime.begin(), byVruntime.end(), greater<pair<long long, int>>());
+            h = byVruntime.back().second;
+            minVruntime = max(minVruntime, byVruntime.back().first);
+            byVruntime.pop_back();
+            return true;
+        }
+
+        bool peek(int &h) {
+            if (byVruntime.empty()) {
+                return false;
+            }
+            h = byVruntime.front().second;
+            return true;
+        }
+
+        int size() {
+            return byVruntime.size();
+        }
+
+        void reserve(int count) {
+            byVruntime.reserve(count);
+        }
+};
+
+// Binary heap on remaining cycles, the process closest to finishing runs first.
+class RemainingQueue {
+    public:
+        vector<pair<int, int>> byRemaining; // heap of (remaining cycles, handle)
+        ProcessTable &processes;
+
+        RemainingQueue(ProcessTable &table) : processes(table) {}
+
+        void push(int h) {
+            byRemaining.push_back(make_pair(processes.remainingCycles[h], h));
+            push_heap(byRemaining.begin(), byRemaining.end(), greater<pair<int, int>>());
+        }
+
+        bool take(int &h) {
+            if (byRemaining.empty()) {
+                return false;
+            }
+            pop_heap(byRemaining.begin(), byRemaining.end(), greater<pair<int, int>>());
+            h = byRemaining.back().second;
+            byRemaining.pop_back();
+            return true;
+        }
+
+        bool peek(int &h) {
+            if (byRemaining.empty()) {
+                return false;
+            }
+            h = byRemaining.front().second;
+            return true;
+        }
+
+        int size() {
+            return byRemaining.size();
+        }
+
+        void reserve(int count) {
+            byRemaining.reserve(count);
+        }
+};
+
+// Latency histogram in the style of HdrHistogram. Values below 64 get a bucket each and every power
+// of two above that is split into 32 buckets, so a bucket is never wider than 1/32 of the values in
+// it. Recording is a bit scan and an increment, and the histograms of several CPUs add up bucket by bucket.
+class LatencyHistogram {
+    public:
+        static const int subBuckets = 32; // buckets per power of two
+        static const int bucketCount = 64 + 57 * subBuckets; // enough for any non negative long long
+        vector<long long> counts = vector<long long>(bucketCount, 0);
+        long long total = 0; // values recorded
+        long long maxValue = 0;
+
+        static int bucketOf(long long value) {
+            if (value < 64) {
+                return (int) max(0LL, value);
+            }
+            int top = 63 - __builtin_clzll(value); // highest set bit, the bucket keeps the 5 bits below it
+            return (top - 5) * subBuckets + (int) (value >> (top - 5));
+        }
+
+        static long long lowest(int bucket) {
+            if (bucket < 64) {
+                return bucket;
+            }
+            return (long long) (bucket % subBuckets + subBuckets) << (bucket / subBuckets - 1);
+        }
+
+        static long long highest(int bucket) {
+            if (bucket < 64) {
+                return bucket;
+            }
+            return lowest(bucket) + (1LL << (bucket / subBuckets - 1)) - 1;
+        }
+
+        void record(long long value) {
+            counts[bucketOf(value)]++;
+            total++;
+            maxValue = max(maxValue, value);
+        }
+
+        void add(const LatencyHistogram &other) {
+            for (int i = 0; i < bucketCount; i++) {
+                counts[i] += other.counts[i];
+            }
+            total += other.total;
+            maxValue = max(maxValue, other.maxValue);
+        }
+
+        template <class Archive>
+        void checkpoint(Archive &a) {
+            a.io(counts);
+            a.io(total);
+            a.io(maxValue);
+            if (Archive::reading && counts.size() != (size_t) bucketCount) {
+                a.fail();
+            }
+        }
+
+        // highest value in the bucket holding the value at fraction of the way through, 0 when empty
+        long long percentile(double fraction) const {
+            long long rank = max(1LL, (long long) ceil(fraction * total));
+            long long seen = 0;
+            for (int i = 0; i < bucketCount; i++) {
+                seen += counts[i];
+                if (seen >= rank) {
+                    return min(highest(i), maxValue);
+                }
+            }
+            return 0;
+        }
+};
+
+// What a simulated CPU counts while it runs, kept next to its run queue.
+class CPUCounters {
+    public:
+        long long dispatches = 0; // number of dispatches done by the CPU that owns this queue
+        long long contextSwitches = 0; // dispatches that loaded a different process than the last one
+        long long busyCycles = 0; // cycles spent running processes
+        int lastProcess = -1; // handle of the last process this CPU ran
+        vector<long long> turnaround, waitingTimes, response; // one entry per process this CPU finished
+        LatencyHistogram turnaroundHistogram, responseHistogram; // the same, for the metrics export
+        long long lastCompletion = 0; // simulated time the last of them finished
+        long long migrations = 0; // dispatches of processes still warm from another CPU
+        long long migrationCycles = 0; // cycles this CPU stalled on them
+
+        virtual ~CPUCounters() {} // run queues of any discipline are owned through this class
+
+        void reserve(int count) {
+            turnaround.reserve(count);
+            waitingTimes.reserve(count);
+            response.reserve(count);
+        }
+
+        template <class Archive>
+        void checkpoint(Archive &a) {
+            a.io(dispatches);
+            a.io(contextSwitches);
+            a.io(busyCycles);
+            a.io(lastProcess);
+            a.io(turnaround);
+            a.io(waitingTimes);
+            a.io(response);
+            turnaroundHistogram.checkpoint(a);
+            responseHistogram.checkpoint(a);
+            a.io(lastCompletion);
+            a.io(migrations);
+            a.io(migrationCycles);
+        }
+};
+
+// Run queue owned by one simulated CPU. The owning worker pushes and pops its own queue, and an
+// idle worker steals from the front of another CPU's queue so the next process in line moves.
+template <class Discipline>
+class RunQueue : public CPUCounters {
+    public:
+        Discipline queued;
+        mutex queueLock;
+
+        RunQueue(ProcessTable &table) : queued(table) {}
+
+        // makes room for count processes in the queue and the counters
+        void reserve(int count) {
+            queued.reserve(count);
+            CPUCounters::reserve(count);
+        }
+
+        void push(int h) {
+            queueLock.lock();
+            queued.push(h);
+            queueLock.unlock();
+        }
+
+        bool pop(int &h) {
+            queueLock.lock();
+            bool found = queued.take(h);
+            queueLock.unlock();
+            return found;
+        }
+
+        // takes the next process in line if worth(h, queued processes) says it should move
+        template <class Worth>
+        bool steal(int &h, Worth worth) {
+            if (!queueLock.try_lock()) { // the owner is busy with its queue, try another CPU
+                return false;
+            }
+            bool found = queued.peek(h) && worth(h, queued.size()) && queued.take(h);
+            queueLock.unlock();
+            return found;
+        }
+};
+
+
+// Simulated IO device. A process that reaches its io point is parked here in the waiting state
+// and the CPU goes on to the next ready process. Requests are served first come first served,
+// each taking serviceCycles of simulated time, and completed processes go back to the run queue
+// of the CPU that collects them.
+class IODevice {
+    public:
+        struct Request {
+            long long doneAt; // simulated time the request completes
+            int h; // process handle
+        };
+        RingQueue<Request> deviceQueue; // completion times only grow so a fifo is kept in order
+        mutex deviceLock;
+        atomic<int> pending{0}; // number of processes waiting on the device
+        int serviceCycles; // cycles a single io request takes
+        long long freeAt = 0; // simulated time the device finishes everything queued on it
+        int completed = 0; // number of io requests served
+        ProcessTable &processes;
+
+        IODevice(ProcessTable &table, int cycles) : processes(table) {
+            serviceCycles = cycles;
+        }
+
+        void request(int h, long long now) {
+            processes.pState[h] = waiting;
+            deviceLock.lock();
+            freeAt = max(freeAt, now) + serviceCycles;
+            deviceQueue.push_back(Request{freeAt, h});
+            processes.ioWaits[h]++;
+            processes.ioWaitCycles[h] += freeAt - now;
+            pending++;
+            deviceLock.unlock();
+        }
+
+        bool busy() {
+            return pending > 0;
+        }
+
+        // drops every request, a run that starts over has no processes waiting on the device
+        void clear() {
+            deviceQueue.clear();
+            pending = 0;
+            freeAt = 0;
+        }
+
+        // moves every request finished by simulated time now into the run queue target
+        template <class Queue>
+        void complete(long long now, Queue &target) {
+            if (!busy()) {
+                return;
+            }
+            deviceLock.lock();
+            while (!deviceQueue.empty() && deviceQueue.front().doneAt <= now) {
+                int h = deviceQueue.front().h;
+                processes.readyAt[h] = deviceQueue.front().doneAt;
+                deviceQueue.pop_front();
+                processes.pState[h] = ready;
+                Trace.record(logInfo, traceIOComplete, processes, h);
+                target.push(h);
+                pending--;
+                completed++;
+            }
+            deviceLock.unlock();
+        }
+
+        template <class Archive>
+        void checkpoint(Archive &a) {
+            vector<Request> requests; // the queue in completion order
+            for (size_t i = 0; i < deviceQueue.size(); i++) {
+                requests.push_back(deviceQueue[i]);
+            }
+            a.io(requests);
+            a.io(serviceCycles);
+            a.io(freeAt);
+            a.io(completed);
+            if (Archive::reading) {
+                deviceQueue.clear();
+                for (Request &r : requests) {
+                    if (r.h < 0 || r.h >= processes.size() || r.doneAt < 0 || r.doneAt > maxRestoredTime) {
+                        a.fail();
+                        return;
+                    }
+                    deviceQueue.push_back(r);
+                }
+                pending = requests.size();
+            }
+        }
+
+        // simulated time of the next io completion, LLONG_MAX when nothing is waiting on the device
+        long long nextCompletion() {
+            if (!busy()) {
+                return LLONG_MAX;
+            }
+            deviceLock.lock();
+            long long doneAt = deviceQueue.empty() ? LLONG_MAX : deviceQueue.front().doneAt;
+            deviceLock.unlock();
+            return doneAt;
+        }
+};
+
+
+// Simulated locks for critical sections. Every critical section takes lock 0 unless its job names
+// another lock or none. A lock with a capacity of 1 is a mutex and a bigger capacity makes it a
+// counting semaphore. A process that reaches its critical section while its lock is full is blocked
+// on the lock's fifo wait queue, and a release hands the lock straight to the first waiter so nothing
+// can barge in between. A process keeps its lock while it waits on io inside the critical section.
+class LockTable {
+    public:
+        static const int maxLocks = 256;
+        struct SimulatedLock {
+            int capacity = 1; // processes that can hold the lock at once
+            int holders = 0;
+            RingQueue<pair<int, long long>> waiters; // blocked process handle and when it blocked
+            long long acquisitions = 0;
+            long long contended = 0; // acquisitions that had to wait
+            long long waitCycles = 0; // cycles processes spent blocked on the lock
+            long long holdCycles = 0; // cycles the lock was held, summed over its holders
+            size_t longestQueue = 0;
+        };
+        vector<SimulatedLock> locks = vector<SimulatedLock>(maxLocks);
+        mutex lockTableLock;
+        ProcessTable &processes;
+
+        LockTable(ProcessTable &table) : processes(table) {}
+
+        // empties every lock and its counters, the capacities stay
+        void reset() {
+            for (SimulatedLock &lock : locks) {
+                int capacity = lock.capacity;
+                lock = SimulatedLock();
+                lock.capacity = capacity;
+            }
+        }
+
+        // takes the lock of process h at simulated time now if it has room, true if h has no lock
+        bool tryAcquire(int h, long long now) {
+            int id = processes.lockId[h];
+            if (id < 0) {
+                return true;
+            }
+            SimulatedLock &lock = locks[id];
+            lockTableLock.lock();
+            bool acquired = lock.holders < lock.capacity;
+            if (acquired) {
+                lock.holders++;
+                lock.acquisitions++;
+                processes.lockedAt[h] = now;
+            }
+            lockTableLock.unlock();
+            return acquired;
+        }
+
+        // queues process h on its full lock once its dispatch has ended. Returns false if the lock
+        // came free in the meantime, h holds it then and is ready to run.
+        bool wait(int h, long long now) {
+            SimulatedLock &lock = locks[processes.lockId[h]];
+            lockTableLock.lock();
+            lock.contended++;
+            bool queued = lock.holders >= lock.capacity;
+            if (queued) {
+                lock.waiters.push_back(make_pair(h, now));
+                lock.longestQueue = max(lock.longestQueue, lock.waiters.size());
+            } else {
+                lock.holders++;
+                lock.acquisitions++;
+                processes.lockedAt[h] = now;
+            }
+            lockTableLock.unlock();
+            return queued;
+        }
+
+        // gives back the lock process h holds at simulated time now. Returns the waiter it was handed
+        // to, which holds it from now on, or -1 when nobody was waiting.
+        int release(int h, long long now) {
+            SimulatedLock &lock = locks[processes.lockId[h]];
+            lockTableLock.lock();
+            lock.holdCycles += now - processes.lockedAt[h];
+            processes.lockedAt[h] = -1;
+            int next = -1;
+            if (lock.waiters.empty()) {
+                lock.holders--;
+            } else {
+                next = lock.waiters.front().first;
+                lock.waitCycles += max(0LL, now - lock.waiters.front().second); // CPU clocks can disagree unless the run is deterministic
+                lock.waiters.pop_front();
+                lock.acquisitions++;
+                processes.lockedAt[next] = now;
+            }
+            lockTableLock.unlock();
+            return next;
+        }
+
+        // counters of every lock that was used, the capacity of the others only if it was changed
+        template <class Archive>
+        void checkpoint(Archive &a) {
+            for (SimulatedLock &lock : locks) {
+                vector<int> waiting; // the wait queue in order, split into handles and when each blocked
+                vector<long long> since;
+                for (size_t i = 0; i < lock.waiters.size(); i++) {
+                    waiting.push_back(lock.waiters[i].first);
+                    since.push_back(lock.waiters[i].second);
+                }
+                a.io(lock.capacity);
+                a.io(lock.holders);
+                a.io(waiting);
+                a.io(since);
+                a.io(lock.acquisitions);
+                a.io(lock.contended);
+                a.io(lock.waitCycles);
+                a.io(lock.holdCycles);
+                a.io(lock.longestQueue);
+                if (Archive::reading) {
+                    lock.waiters.clear();
+                    if (waiting.size() != since.size() || lock.capacity < 1 || lock.holders < 0
+                            || lock.acquisitions < 0 || lock.contended < 0 || lock.waitCycles < 0 || lock.waitCycles > maxRestoredTime
+                            || lock.holdCycles < 0 || lock.holdCycles > maxRestoredTime) {
+                        a.fail();
+                        return;
+                    }
+                    for (size_t i = 0; i < waiting.size(); i++) {
+                        if (waiting[i] < 0 || waiting[i] >= processes.size() || since[i] < 0 || since[i] > maxRestoredTime) {
+                            a.fail();
+                            return;
+                        }
+                        lock.waiters.push_back(make_pair(waiting[i], since[i]));
+                    }
+                }
+            }
+        }
+
+        void printStats() {
+            cout << "\nLock  capacity  acquisitions  contended  wait cycles  hold cycles  longest queue";
+            for (int id = 0; id < maxLocks; id++) {
+                SimulatedLock &lock = locks[id];
+                if (lock.acquisitions > 0 || lock.capacity != 1) {
+                    cout << "\n" << id << "  " << lock.capacity << "  " << lock.acquisitions << "  " << lock.contended << "  "
+                         << lock.waitCycles << "  " << lock.holdCycles << "  " << lock.longestQueue;
+                }
+            }
+        }
+};
+
+
+// global variables
+    bool verbose = true; // loaders print what they create, turned off in batch mode
+
+// Something that happens to process h at simulated time at. order breaks ties between events at the
+// same time, the one given the lower order comes first.
+struct TimedEvent {
+    long long at;
+    long long order;
+    int h;
+};
+
+struct LaterEvent {
+    bool operator()(const TimedEvent &a, const TimedEvent &b) const {
+        return a.at > b.at || (a.at == b.at && a.order > b.order);
+    }
+};
+
+// Hierarchical timing wheel of future events. Level l has 64 slots of 64^l cycles each and covers the
+// 64^(l+1) cycles around the wheel's current time, so adding an event is a bit scan to find its level
+// and a push onto a slot, however many events are waiting. Moving the current time forward jumps
+// straight to the next occupied slot through a bitmap per level, and reaching a slot of a higher level
+// spreads its events over the levels below. Events more than 64^6 cycles ahead wait in an overflow list.
+// Events that are due go on a small heap, so they come out in time and then order, exactly like a
+// priority queue of every event would give them. Slots keep their memory, so a wheel that has warmed up
+// doesn't allocate. The owner does the locking.
+class TimingWheel {
+    public:
+        static const int levelBits = 6;
+        static const int slotCount = 1 << levelBits;
+        static const int levels = 6;
+        vector<TimedEvent> slots[levels][slotCount];
+        uint64_t occupied[levels] = {}; // bit s is set while slot s of the level holds events
+        vector<TimedEvent> overflow; // events beyond the last level
+        vector<TimedEvent> due; // heap of the events at or before current
+        vector<TimedEvent> spreading; // events of the slot being spread over the lower levels
+        long long current = 0; // every event at or before this time is on the due heap
+        size_t count = 0;
+
+        bool empty() const {
+            return count == 0;
+        }
+
+        size_t size() const {
+            return count;
+        }
+
+        void clear() {
+            for (int l = 0; l < levels; l++) {
+                for (int slot = 0; slot < slotCount; slot++) {
+                    slots[l][slot].clear();
+                }
+                occupied[l] = 0;
+            }
+            overflow.clear();
+            due.clear();
+            current = 0;
+            count = 0;
+        }
+
+        void push(const TimedEvent &e) {
+            place(e);
+            count++;
+        }
+
+        // takes the earliest event at or before now, false when there is none
+        bool take(long long now, TimedEvent &e) {
+            if (now > current) {
+                advance(now);
+            }
+            if (due.empty() || due.front().at > now) {
+                return false;
+            }
+            pop_heap(due.begin(), due.end(), LaterEvent());
+            e = due.back();
+            due.pop_back();
+            count--;
+            return true;
+        }
+
+        // time of the earliest event, LLONG_MAX when there is none
+        long long next() {
+            if (!due.empty()) { // everything on the due heap comes before the wheel
+                return due.front().at;
+            }
+            for (int l = 0; l < levels; l++) {
+                uint64_t ahead = slotsAfter(l);
+                if (ahead != 0) {
+                    int slot = __builtin_ctzll(ahead);
+                    if (l == 0) {
+                        return slotStart(0, slot);
+                    }
+                    return earliest(slots[l][slot]);
+                }
+            }
+            return earliest(overflow);
+        }
+
+        // every event in time and then order
+        vector<TimedEvent> events() {
+            vector<TimedEvent> all = due;
+            for (int l = 0; l < levels; l++) {
+                for (int slot = 0; slot < slotCount; slot++) {
+                    all.insert(all.end(), slots[l][slot].begin(), slots[l][slot].end());
+                }
+            }
+            all.insert(all.end(), overflow.begin(), overflow.end());
+            sort(all.begin(), all.end(), [](const TimedEvent &a, const TimedEvent &b) { return LaterEvent()(b, a); });
+            return all;
+        }
+
+        // occupied slots of level l after the one current is in
+        uint64_t slotsAfter(int l) {
+            int index = (current >> (l * levelBits)) & (slotCount - 1);
+            return index == slotCount - 1 ? 0 : occupied[l] & (~0ULL << (index + 1));
+        }
+
+        // first cycle of slot of level l in the wheel around current
+        long long slotStart(int l, int slot) {
+            int above = (l + 1) * levelBits;
+            return (current >> above << above) | ((long long) slot << (l * levelBits));
+        }
+
+        long long earliest(const vector<TimedEvent> &events) {
+            long long first = LLONG_MAX;
+            for (const TimedEvent &e : events) {
+                first = min(first, e.at);
+            }
+            return first;
+        }
+
+        void place(const TimedEvent &e) {
+            if (e.at <= current) {
+                due.push_back(e);
+                push_heap(due.begin(), due.end(), LaterEvent());
+                return;
+            }
+            int l = (63 - __builtin_clzll((uint64_t) (e.at ^ current))) / levelBits; // the highest bit they differ in picks the level
+            if (l >= levels) {
+                overflow.push_back(e);
+                return;
+            }
+            int slot = (e.at >> (l * levelBits)) & (slotCount - 1);
+            slots[l][slot].push_back(e);
+            occupied[l] |= 1ULL << slot;
+        }
+
+        // moves every event in from to the level it belongs on now
+        void spread(vector<TimedEvent> &from) {
+            spreading.swap(from);
+            for (const TimedEvent &e : spreading) {
+                place(e);
+            }
+            spreading.clear();
+        }
+
+        // moves current forward to now, putting every event up to it on the due heap
+        void advance(long long now) {
+            while (current < now) {
+                int l = 0;
+                uint64_t ahead = 0;
+                while (l < levels && (ahead = slotsAfter(l)) == 0) {
+                    l++;
+                }
+                if (l == levels) { // the wheel is empty, only the overflow can hold anything
+                    long long first = earliest(overflow);
+                    long long to = min(first, now);
+                    bool newWheel = (to >> (levels * levelBits)) != (current >> (levels * levelBits));
+                    current = to;
+                    if (newWheel) {
+                        spread(overflow);
+                    }
+                    if (first > now) {
+                        return;
+                    }
+                    continue;
+                }
+                int slot = __builtin_ctzll(ahead);
+                long long start = slotStart(l, slot);
+                if (start > now) { // the levels below are empty, so nothing happens before start
+                    current = now;
+                    return;
+                }
+                current = start;
+                occupied[l] &= ~(1ULL << slot);
+                spread(slots[l][slot]);
+            }
+        }
+};
+
+// Processes that have not arrived yet. Every process has an arrival time on the simulated timeline
+// and sits here in the newP state until a CPU clock reaches it, then it joins that CPU's run queue.
+// In a streamed run a producer thread keeps reading or generating processes while the schedulers
+// run. It only gets a small block of table slots and waits for a process to terminate when they are
+// all taken, so the process table stays the size of the active set instead of the whole workload.
+// While the producer can still hand processes over, a CPU doesn't run past the arrival time of the
+// last one it handed over, so streamed processes join the run queues on time however far ahead of
+// the producer the schedulers are.
+class ArrivalQueue {
+    public:
+        typedef TimedEvent Arrival; // order keeps processes arriving at the same time in the order they were read
+        TimingWheel pending;
+        mutex arrivalLock;
+        atomic<long long> nextAt{LLONG_MAX}; // earliest pending arrival so CPUs can check without the lock
+        long long order = 0;
+        atomic<bool> producing{false}; // a producer is still streaming processes in
+
+        int firstSlot = 0; // the streamed processes reuse handles firstSlot to firstSlot + slotCount - 1
+        int slotCount = 0;
+        vector<int> freeSlots;
+        mutex slotLock;
+        condition_variable slotFree;
+        long long streamed = 0; // processes the producer handed over
+        atomic<int> freeCount{0}; // free slots, only drops once the process in the slot is queued
+        atomic<long long> lastStreamed{LLONG_MIN}; // arrival time of the last process handed over
+        ProcessTable &processes;
+        atomic<int> &live; // processes of the simulation that have not terminated
+
+        ArrivalQueue(ProcessTable &table, atomic<int> &liveProcesses) : processes(table), live(liveProcesses) {}
+
+        void clear() {
+            pending.clear();
+            nextAt = LLONG_MAX;
+            order = 0;
+            producing = false;
+            firstSlot = 0;
+            slotCount = 0;
+            freeSlots.clear();
+            streamed = 0;
+            freeCount = 0;
+            lastStreamed = LLONG_MIN;
+        }
+
+        // adds a process that arrives later on
+        void push(int h) {
+            arrivalLock.lock();
+            pending.push(Arrival{processes.arrival[h], order++, h});
+            nextAt = min(nextAt.load(), processes.arrival[h]);
+            arrivalLock.unlock();
+        }
+
+        // moves every process that has arrived by simulated time now into the run queue target
+        template <class Queue>
+        void admit(long long now, Queue &target) {
+            if (nextAt.load(memory_order_relaxed) > now) {
+                return;
+            }
+            arrivalLock.lock();
+            for (Arrival arrival; pending.take(now, arrival);) {
+                int h = arrival.h;
+                processes.pState[h] = ready;
+                Trace.record(logInfo, traceArrival, processes, h, processes.arrival[h]);
+                target.push(h);
+            }
+            nextAt = pending.next();
+            arrivalLock.unlock();
+        }
+
+        // the processes still to arrive, only between runs or in a stopped run so no producer is streaming
+        template <class Archive>
+        void checkpoint(Archive &a) {
+            vector<Arrival> arrivals = pending.events();
+            a.io(arrivals);
+            a.io(order);
+            if (Archive::reading) {
+                pending.clear();
+                for (Arrival &arrival : arrivals) {
+                    if (arrival.h < 0 || arrival.h >= processes.size() || arrival.at < 0 || arrival.at > maxRestoredTime) {
+                        a.fail();
+                        return;
+                    }
+                    pending.push(arrival);
+                }
+                nextAt = pending.next();
+            }
+        }
+
+        // gives the producer slots handles first to first + count - 1
+        void useSlots(int first, int count) {
+            firstSlot = first;
+            slotCount = count;
+            for (int h = first + count - 1; h >= first; h--) { // the lowest handle is used first
+                freeSlots.push_back(h);
+            }
+            freeCount = count;
+        }
+
+        // true while the producer may still hand over a process arriving at or before simulated time t
+        bool behind(long long t) {
+            return producing && freeCount > 0 && lastStreamed <= t;
+        }
+
+        // called by the producer for each process, waits until a slot is free
+        void stream(const JobSpec &job, int p) {
+            unique_lock<mutex> lock(slotLock);
+            slotFree.wait(lock, [this] { return !freeSlots.empty(); });
+            int h = freeSlots.back();
+            freeSlots.pop_back();
+            lock.unlock();
+            processes.set(h, p, job);
+            live++; // counted before producing can drop to false
+            streamed++;
+            push(h);
+            lastStreamed = job.arrival;
+            freeCount--; // a CPU waiting on the producer can tell it is blocked only once the process is queued
+        }
+
+        // gives the slot of a terminated process back to the producer
+        void release(int h) {
+            if (h < firstSlot || h >= firstSlot + slotCount) {
+                return;
+            }
+            slotLock.lock();
+            freeSlots.push_back(h);
+            freeCount++; // before the producer wakes up so no CPU gets ahead of it meanwhile
+            slotLock.unlock();
+            slotFree.notify_one();
+        }
+};
+
+// Processes asleep in a SLEEP of their program. Each one waits on the timing wheel for the simulated
+// time its sleep ends, and a CPU whose clock gets there puts it back in its run queue, so waking any
+// number of sleepers never looks at the ones still asleep.
+class SleepQueue {
+    public:
+        TimingWheel sleepers;
+        mutex sleepLock;
+        atomic<long long> nextAt{LLONG_MAX}; // earliest wake up so CPUs can check without the lock
+        long long order = 0;
+        ProcessTable &processes;
+
+        SleepQueue(ProcessTable &table) : processes(table) {}
+
+        void clear() {
+            sleepers.clear();
+            nextAt = LLONG_MAX;
+            order = 0;
+        }
+
+        // puts process h to sleep until simulated time until
+        void sleep(int h, long long until) {
+            processes.pState[h] = sleeping;
+            sleepLock.lock();
+            sleepers.push(TimedEvent{until, order++, h});
+            nextAt = min(nextAt.load(), until);
+            sleepLock.unlock();
+        }
+
+        // moves every process whose sleep is over by simulated time now into the run queue target
+        template <class Queue>
+        void wake(long long now, Queue &target) {
+            if (nextAt.load(memory_order_relaxed) > now) {
+                return;
+            }
+            sleepLock.lock();
+            for (TimedEvent e; sleepers.take(now, e);) {
+                processes.pState[e.h] = ready;
+                processes.readyAt[e.h] = e.at;
+                Trace.record(logInfo, traceWake, processes, e.h);
+                target.push(e.h);
+            }
+            nextAt = sleepers.next();
+            sleepLock.unlock();
+        }
+
+        template <class Archive>
+        void checkpoint(Archive &a) {
+            vector<TimedEvent> asleep = sleepers.events();
+            a.io(asleep);
+            a.io(order);
+            if (Archive::reading) {
+                sleepers.clear();
+                for (TimedEvent &e : asleep) {
+                    if (e.h < 0 || e.h >= processes.size() || e.at < 0 || e.at > maxRestoredTime) {
+                        a.fail();
+                        return;
+                    }
+                    sleepers.push(e);
+                }
+                nextAt = sleepers.next();
+            }
+        }
+};
+
+// splitmix64, a small and fast seeded generator for the workload generators. Each simulation has
+// its own so simulations on different threads never share one, and a seed always gives the same
+// workload. Returns numbers from 0 to INT_MAX like rand() and works with the <random> distributions.
+class FastRandom {
+    public:
+        typedef uint32_t result_type;
+        uint64_t state;
+
+        FastRandom(uint64_t seed = 1) {
+            state = seed;
+        }
+
+        static constexpr result_type min() {
+            return 0;
+        }
+
+        static constexpr result_type max() {
+            return INT_MAX;
+        }
+
+        result_type operator()() {
+            uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            return (result_type) ((z ^ (z >> 31)) >> 33);
+        }
+};
+
+struct RunSummary;
+
+// How a generated value is drawn. uniform picks evenly from low to high, exponential has a mean of
+// low and pareto is heavy tailed: never below low, most values close to it and a few far above, the
+// smaller the shape the more. exponential and pareto are capped at high. A high of 0 means the end,
+// the last cycle of the process for the critical section start and the io point.
+struct Distribution {
+    enum Kind { uniform, exponential, pareto };
+    Kind kind = uniform;
+    double low = 0;
+    double high = 0;
+    double shape = 1.5; // pareto only
+
+    // a value for a field whose end is end
+    int draw(FastRandom &random, int end) const {
+        int top = high > 0 ? (int) high : end - 1;
+        if (kind == uniform) {
+            int lowest = (int) low;
+            return top > lowest ? (int) (random() % (uint32_t) (top - lowest + 1)) + lowest : lowest;
+        }
+        double u = (random() + 0.5) / 2147483648.0; // uniform in (0, 1)
+        double value = kind == exponential ? -low * log(u) : low / pow(u, 1 / shape);
+        return (int) min(value, (double) top);
+    }
+
+    string text() const {
+        ostringstream out;
+        if (kind == uniform) {
+            out << "uniform:" << low << ":" << high;
+        } else if (kind == exponential) {
+            out << "exponential:" << low << ":" << high;
+        } else {
+            out << "pareto:" << low << ":" << shape << ":" << high;
+        }
+        return out.str();
+    }
+};
+
+// parses uniform:<low>:<high>, exponential:<mean>[:<cap>] or pareto:<low>:<shape>[:<cap>], returns false if it isn't one
+bool parseDistribution(const string &text, Distribution &d) {
+    vector<double> numbers;
+    stringstream parts(text);
+    string kind, part;
+    getline(parts, kind, ':');
+    while (getline(parts, part, ':')) {
+        char *end = nullptr;
+        numbers.push_back(strtod(part.c_str(), &end));
+        if (part.empty() || *end != '\0' || numbers.back() < 0) {
+            return false;
+        }
+    }
+    Distribution parsed;
+    if (kind == "uniform" && numbers.size() == 2 && (numbers[1] == 0 || numbers[1] >= numbers[0])) {
+        parsed.high = numbers[1];
+    } else if ((kind == "exponential" || kind == "exp") && (numbers.size() == 1 || numbers.size() == 2) && numbers[0] > 0) {
+        parsed.kind = Distribution::exponential;
+        parsed.high = numbers.size() == 2 ? numbers[1] : 0;
+    } else if (kind == "pareto" && (numbers.size() == 2 || numbers.size() == 3) && numbers[0] > 0 && numbers[1] > 0) {
+        parsed.kind = Distribution::pareto;
+        parsed.shape = numbers[1];
+        parsed.high = numbers.size() == 3 ? numbers[2] : 0;
+    } else {
+        return false;
+    }
+    parsed.low = numbers[0];
+    d = parsed;
+    return true;
+}
+
+// The shape of generated processes, each field drawn from its own distribution. The defaults are the
+// simulator's first workload: 51 to 250 cycles, priority 0 to 2, a critical section of 21 to 60
+// cycles and an io point, both starting somewhere from cycle 31 to the end.
+struct Workload {
+    Distribution cycles{Distribution::uniform, 51, 250};
+    Distribution priority{Distribution::uniform, 0, 2};
+    Distribution criticalStart{Distribution::uniform, 31, 0};
+    Distribution criticalLength{Distribution::uniform, 21, 60};
+    Distribution inputOutput{Distribution::uniform, 31, 0};
+
+    void draw(FastRandom &random, JobSpec &job) const {
+        job.name = "generated";
+        job.cycles = max(1, cycles.draw(random, INT_MAX / 2));
+        job.priority = max(0, priority.draw(random, 3)); // capped at 2 unless high says otherwise
+        job.criticalStart = criticalStart.draw(random, job.cycles);
+        job.criticalLength = criticalLength.draw(random, INT_MAX / 2);
+        job.inputOutput = inputOutput.draw(random, job.cycles);
+    }
+
+    // the distribution a flag or the workload command names, nullptr if there is none
+    Distribution *field(const string &name) {
+        if (name == "cycles") {
+            return &cycles;
+        } else if (name == "priorities") {
+            return &priority;
+        } else if (name == "critical-start") {
+            return &criticalStart;
+        } else if (name == "critical-length") {
+            return &criticalLength;
+        } else if (name == "io-point") {
+            return &inputOutput;
+        }
+        return nullptr;
+    }
+};
+
+// Where the simulated CPUs sit. CPUs are numbered through coresPerCache of them sharing a cache and
+// cachesPerNode caches making up a NUMA node, 0 puts them all in one. A process that runs on another CPU
+// than last time while its cache is still warm, within warmth cycles of its last dispatch, stalls for
+// the migration cost of how far it moved. The aware balancer has an idle CPU steal from the nearest
+// CPUs first and only take a process when the queue it leaves would make it wait longer than moving
+// costs. The free balancer steals from the next CPU over that has work, as if moving were free.
+struct Topology {
+    static const int maxCost = 999999999; // cycles, the most a migration cost can be
+    int coresPerCache = 0;
+    int cachesPerNode = 0;
+    int migrationCost[3] = { 0, 0, 0 }; // cycles a move costs within a cache, to another cache of the node and to another node
+    int warmth = 5000;
+    bool aware = true;
+
+    // 0 for CPUs sharing a cache, 1 for another cache of the same node, 2 for another node
+    int distance(int a, int b) const {
+        int cacheA = coresPerCache > 0 ? a / coresPerCache : 0;
+        int cacheB = coresPerCache > 0 ? b / coresPerCache : 0;
+        if (cacheA == cacheB) {
+            return 0;
+        }
+        if (cachesPerNode == 0 || cacheA / cachesPerNode == cacheB / cachesPerNode) {
+            return 1;
+        }
+        return 2;
+    }
+
+    template <class Archive>
+    void checkpoint(Archive &a) {
+        a.io(coresPerCache);
+        a.io(cachesPerNode);
+        for (int &cost : migrationCost) {
+            a.io(cost);
+        }
+        a.io(warmth);
+        a.io(aware);
+    }
+
+    // true if no cost can move a CPU clock backwards or past maxCost
+    bool valid() const {
+        for (int cost : migrationCost) {
+            if (cost < 0 || cost > maxCost) {
+                return false;
+            }
+        }
+        return warmth >= 0 && coresPerCache >= 0 && cachesPerNode >= 0;
+    }
+
+    // true if the caches split cpus CPUs evenly and the nodes split the caches evenly
+    bool fits(int cpus) const {
+        if (!valid() || (coresPerCache > 0 && cpus % coresPerCache != 0)) {
+            return false;
+        }
+        int caches = coresPerCache > 0 ? cpus / coresPerCache : 1;
+        return cachesPerNode == 0 || caches % cachesPerNode == 0;
+    }
+
+    string text() const {
+        stringstream out;
+        out << (coresPerCache > 0 ? to_string(coresPerCache) : "all") << " CPUs per cache, "
+            << (cachesPerNode > 0 ? to_string(cachesPerNode) : "all") << " caches per node, migrations cost "
+            << migrationCost[0] << "/" << migrationCost[1] << "/" << migrationCost[2] << " cycles within " << warmth
+            << " cycles of the last dispatch, " << (aware ? "aware" : "free") << " balancer";
+        return out.str();
+    }
+};
+
+// reads count numbers separated by colons, each at least 0
+bool colonNumbers(const string &text, int count, int *numbers) {
+    stringstream parts(text);
+    string part;
+    int found = 0;
+    while (getline(parts, part, ':')) {
+        if (found == count || part.empty() || part.size() > 9 || part.find_first_not_of("0123456789") != string::npos) {
+            return false;
+        }
+        numbers[found++] = stoi(part);
+    }
+    return found == count;
+}
+
+// <CPUs per cache>:<caches per node>
+bool parseTopology(const string &text, Topology &topology) {
+    int numbers[2];
+    if (!colonNumbers(text, 2, numbers)) {
+        return false;
+    }
+    topology.coresPerCache = numbers[0];
+    topology.cachesPerNode = numbers[1];
+    return true;
+}
+
+// <cache>:<node>:<remote> migration costs in cycles
+bool parseMigration(const string &text, Topology &topology) {
+    int numbers[3];
+    if (!colonNumbers(text, 3, numbers)) {
+        return false;
+    }
+    copy(numbers, numbers + 3, topology.migrationCost);
+    return true;
+}
+
+// A run that stopped once every CPU clock reached Simulation::stopAt. The run queues are kept as
+// lists of handles in the order each CPU would have run them, so the next run carries on from here
+// under any scheduler.
+struct PausedRun {
+    bool active = false;
+    vector<long long> clocks; // simulated time on each CPU when it stopped
+    vector<long long> boosts; // simulated time each CPU's feedback queue would have been boosted next
+    vector<vector<int>> queued; // each CPU's run queue
+    vector<CPUCounters> counters; // each CPU's counters so far
+};
+
+// One simulated machine: its processes, memory, io device, run queues and settings, and the
+// generator its workloads come from. The command prompt and batch mode drive the one Simulator,
+// the sweep runs many simulations side by side, one per host thread.
+class Simulation {
+    public:
+        ProcessTable Processes; // every process this simulation knows about
+        int numberOfProcesses = 0; // keeps track of the number of process created thus far so the pids don't overlap
+        queue<int> readyQueue; // empty readyQueue of process handles, spread over the CPUs when a scheduler runs
+        atomic<int> liveProcesses{0}; // processes handed to the schedulers that have not terminated yet
+        atomic<long long> workerAllocations{0}; // heap allocations the worker and producer threads of the run made
+        vector<unique_ptr<CPUCounters>> runQueues; // one run queue per simulated CPU, of the queue type of the running policy
+        int numberOfCPUs = 2; // number of simulated CPUs the schedulers run on
+        int quantum = 20; // round robin quantum, the priority scheduler adds 5 cycles per priority level
+        int boostPeriod = 1000; // cycles between the feedback scheduler moving every process back to the top level
+        bool interleaved = false; // runs every simulated CPU on the calling thread so each run turns out the same
+        Topology topology; // caches and nodes of the CPUs, migration costs and the load balancer
+        vector<vector<int>> stealOrder; // the CPUs each idle CPU of the run tries to steal from, in turn
+        uint64_t runMask = 0; // bit c is set for each CPU c of the run
+        Memory MainMemory{Processes};
+        IODevice Disk{Processes, 50}; // io requests take 50 cycles
+        ArrivalQueue Arrivals{Processes, liveProcesses}; // processes waiting for their arrival time
+        SleepQueue Sleepers{Processes}; // processes in a SLEEP of their program
+        LockTable Locks{Processes}; // locks and semaphores the critical sections take
+        mutex mtx;
+        FastRandom random; // generates this simulation's processes
+        Workload workload; // what the generated processes look like
+        int generateThreads = 0; // host threads generateProcesses fills the table with, 0 for every core
+        string metricsPath; // every run writes its metrics here when set
+        string schedulePath; // every run records its schedule trace here when set
+        ScheduleTrace Schedule; // the schedule trace of the run going on
+        vector<int> lastRun; // handles of the processes the last run started with
+        long long stopAt = 0; // runs stop once every CPU clock reaches this cycle, 0 runs them to the end
+        long long stopClock = LLONG_MAX; // stopAt of the run going on, streamed runs always run to the end
+        vector<long long> clocks; // simulated time on each CPU
+        vector<long long> boosts; // simulated time each CPU next moves its feedback queue back to level 0
+        PausedRun paused; // the last run if it stopped at stopAt, the next run resumes it
+
+        Simulation(uint64_t seed = 1) : random(seed) {}
+
+        // run queue of a CPU, Queue has to be the queue type of the running policy
+        template <class Queue>
+        Queue &runQueue(int cpu) {
+            return static_cast<Queue &>(*runQueues[cpu]);
+        }
+
+        void generateProcesses(int number);
+        void ioInterrupt(int h);
+        int runProgram(int h, int quantum);
+        int runBurst(int h, int quantum, long long start);
+        long long nextEvent();
+        bool allowedOn(int cpu, int h);
+        int homeCPU(int h, int preferred);
+        int migrationCost(int cpu, int h, long long clock);
+        template <class Queue>
+        bool popAllowed(int cpu, Queue &own, int &next);
+        template <class Queue>
+        bool nextProcess(int cpu, long long &clock, int &next);
+        void startDispatch(CPUCounters &own, int current, long long &clock);
+        void recordBurst(int cpu, int h, long long start, int used, int critical, int pagesIn, int pagesOut, long long end);
+        template <class Queue>
+        void finishDispatch(Queue &own, int current, long long clock);
+        template <class Policy>
+        bool stepCPU(int cpu, long long &clock, Policy &policy);
+        template <class Policy>
+        void runCPU(int cpu);
+        template <class Policy>
+        void runInterleaved(int cpus);
+        template <class Policy>
+        RunSummary runSchedulers(int cpus, function<void()> producer, int activeLimit);
+        void printSummary(RunSummary &s, const string &format);
+        bool writeMetrics(RunSummary &s, const string &path);
+        void scaleSchedulers(RunSummary (Simulation::*scheduler)(int, function<void()>, int), int maxCPUs);
+        void addUserProcess(int numProc);
+        bool loadBinaryJobs(const string &path, const char *data, size_t size, string &error);
+        bool writeBinaryJobs(const string &path, int first, int last);
+        bool loadJobFile(const string &path);
+        void addProgram(const string &path, int count);
+        void addFile(string path);
+        bool convertJobFile(const string &textPath, const string &binaryPath);
+        void streamJobFile(string path);
+        void streamGenerated(int count, double meanGap);
+        template <class Archive>
+        void checkpointState(Archive &a);
+        bool saveCheckpoint(const string &path);
+        bool restoreCheckpoint(const string &path, const char *data, size_t size, string &error);
+        bool loadCheckpoint(const string &path);
+};
+
+Simulation Simulator; // the simulation the command prompt and batch mode work on
+
+void helpMenu() {
+    cout << "\nList of commands: help";
+    cout << "\nAdd a job: add <path to jobFile>";
+    cout << "\nConvert a job file to the binary format: convert <jobFile> <binary jobFile>";
+    cout << "\nCreate a process: create process";
+    cout << "\nCreate processes running a program file: program <programFile> <count>";
+    cout << "\nGenerate processes: generate";
+    cout << "\nSet how generated processes look: workload <cycles|priorities|critical-start|critical-length|io-point> <distribution>,";
+    cout << "\n  a distribution is uniform:<low>:<high>, exponential:<mean>[:<cap>] or pareto:<low>:<shape>[:<cap>], or workload to see them";
+    cout << "\nRun the round robin: run round";
+    cout << "\nRun the priority: run priority";
+    cout << "\nRun the multilevel feedback queue: run mlfq";
+    cout << "\nRun the fair share scheduler: run fair";
+    cout << "\nRun shortest remaining time first: run srtf";
+    cout << "\nSet how often the feedback queue moves everything back to the top level: boost <cycles>";
+    cout << "\nSet the number of CPUs: cpus <number>";
+    cout << "\nSet the round robin quantum: quantum <cycles>";
+    cout << "\nSet the seed the generated processes come from: seed <number>";
+    cout << "\nLet count processes hold a critical section lock at once: semaphore <lock> <count>";
+    cout << "\nShow the contention on each critical section lock: locks";
+    cout << "\nWrite per process metrics and latency histograms after every run: metrics <file.csv|file.json>, or metrics off";
+    cout << "\nSet how much the schedulers print: log quiet, log info or log debug";
+    cout << "\nSet up the memory: memory <frames> <fifo|lru|clock|ws> [frame size in MB], or memory to see its counters";
+    cout << "\nSet what a page fault costs and the working set window: paging <fault cycles> <window cycles>";
+    cout << "\nGroup the CPUs into caches and NUMA nodes: topology <cpus per cache> <caches per node>, or topology to see it";
+    cout << "\nSet what moving a warm process costs: migration <cache> <node> <remote> [warmth cycles]";
+    cout << "\nPick how idle CPUs steal work: balance free or balance aware";
+    cout << "\nCompare throughput up to a CPU count: scale <round|priority|mlfq|fair|srtf> <cpus>";
+    cout << "\nRun while a job file is read in: stream <round|priority|mlfq|fair|srtf> <jobFile>";
+    cout << "\nRun while processes are generated: stream <round|priority|mlfq|fair|srtf> generate <count> <mean cycles between arrivals>";
+    cout << "\nStop runs once every CPU reaches a cycle, the next run carries on: stop <cycle>, or stop 0 to run to the end";
+    cout << "\nSave the simulation and any stopped run to a file: checkpoint <file>";
+    cout << "\nReplace the simulation with a saved one: restore <file>";
+    cout << "\nRecord a schedule trace of every run: record <file>, or record off";
+    cout << "\nShow what a schedule trace says about its run: replay <file> [gantt.csv]";
+}
+
+// Fills number new processes straight into the process table. The table grows once and is cut into
+// chunks of 64K processes that host threads take in turn. Each chunk has its own generator seeded
+// from this simulation's generator and the chunk number, so the workload only depends on the seed
+// and never on how many threads filled it.
+void Simulation::generateProcesses(int number) {
+    if (number <= 0) {
+        return;
+    }
+    const int chunk = 1 << 16;
+    int first = Processes.grow(number);
+    int name = Names.intern("generated");
+    uint64_t seed = (uint64_t) random() << 31 | random(); // the next generate call gets a different workload
+    int chunks = (number + chunk - 1) / chunk;
+    atomic<int> nextChunk{0};
+    auto fill = [&] {
+        JobSpec job;
+        for (int c = nextChunk++; c < chunks; c = nextChunk++) {
+            FastRandom mix(seed + c);
+            FastRandom chunkRandom((uint64_t) mix() << 31 | mix()); // far apart in the sequence from every other chunk
+            for (int i = c * chunk; i < min(number, (c + 1) * chunk); i++) {
+                workload.draw(chunkRandom, job);
+                Processes.set(first + i, numberOfProcesses + i, job, name);
+            }
+        }
+    };
+    int threads = min(chunks, generateThreads > 0 ? generateThreads : (int) max(1u, thread::hardware_concurrency()));
+    vector<thread> pool;
+    for (int i = 1; i < threads; i++) {
+        pool.push_back(thread(fill));
+    }
+    fill();
+    for (thread &t : pool) {
+        t.join();
+    }
+    numberOfProcesses += number;
+    for (int h = first; h < first + number; h++) {
+        readyQueue.push(h);
+    }
+}
+
+// a process reached its io point, it waits for the io device off the CPU
+void Simulation::ioInterrupt(int h) {
+    Trace.record(logInfo, traceIOInterrupt, Processes, h);
+    Processes.pState[h] = waiting; // the process waits on the io device instead of holding the CPU
+}
+
+// Interpreter for processes that run a program. Each dispatch executes instructions from the
+// process' ip until the quantum is used up, the process blocks on I/O, yields or sleeps, or the program ends.
+// A CALCULATE takes as many cycles as it can in one step and picks up where it left off next time.
+// OUT and a CALCULATE of 0 cycles cost nothing. The end of the program terminates the process.
+int Simulation::runProgram(int h, int quantum) {
+    const int *&ip = Processes.ip[h];
+    int &stepLeft = Processes.stepLeft[h];
+    int &remainingCycles = Processes.remainingCycles[h];
+    int used = 0; // cycles spent on the CPU during this dispatch
+    while (true) {
+        int instruction = *ip;
+        switch (instruction & opMask) {
+            case opCalculate: {
+                if (used == quantum) {
+                    return used;
+                }
+                if (stepLeft == 0) { // starting this CALCULATE
+                    stepLeft = instruction >> opBits;
+                }
+                int slice = min(stepLeft, quantum - used);
+                used += slice;
+                stepLeft -= slice;
+                remainingCycles -= slice;
+                if (stepLeft > 0) { // the quantum ended in the middle of the CALCULATE
+                    return used;
+                }
+                ip++;
+                break;
+            }
+            case opIO:
+                ip++;
+                ioInterrupt(h);
+                return used;
+            case opYield:
+                ip++;
+                Trace.record(logInfo, traceYield, Processes, h);
+                return used;
+            case opOut:
+                ip++;
+                Trace.record(logInfo, traceOut, Processes, h, instruction >> opBits);
+                break;
+            case opSleep:
+                ip++;
+                stepLeft = instruction >> opBits; // finishDispatch puts the process to sleep for this long
+                Processes.pState[h] = sleeping;
+                Trace.record(logInfo, traceSleep, Processes, h, stepLeft);
+                return used;
+            default: // opEnd
+                remainingCycles = -1; // finishDispatch terminates the process
+                return used;
+        }
+    }
+}
+
+// Discrete event core used by both schedulers. Instead of stepping the CPU one cycle at a time
+// it jumps straight to the next interesting point of a dispatch: the io point, the start of the
+// critical section or the end of the quantum. The critical section start ends the quantum early,
+// a cycle that starts the critical section does not check for io, and the critical section runs
+// before the process is switched. Reaching the io point blocks the process and ends the dispatch.
+// Processes that run a program go to the interpreter instead. Returns the number of cycles the
+// process spent on the CPU.
+int Simulation::runBurst(int h, int quantum, long long start) {
+    if (Processes.ip[h] != nullptr) {
+        return runProgram(h, quantum);
+    }
+    int &remainingCycles = Processes.remainingCycles[h];
+    int &criticalStart = Processes.criticalStart[h];
+    int &criticalLeft = Processes.criticalLeft[h];
+    int &inputOutput = Processes.inputOutput[h];
+    int used = 0; // cycles spent on the CPU during this dispatch
+    if (criticalLeft == 0) { // not resuming a critical section that was interrupted by io
+        int slice = quantum; // cycles until the next event
+        bool critical = false;
+        if (criticalStart >= 1 && criticalStart <= quantum) { // critical section starts during this quantum
+            slice = criticalStart;
+            critical = true;
+        }
+        if (inputOutput >= 1 && (inputOutput < slice || (inputOutput == slice && !critical))) {
+            slice = inputOutput; // io point is reached before the quantum ends
+            remainingCycles -= slice;
+            criticalStart -= slice;
+            inputOutput = 0;
+            ioInterrupt(h);
+            return slice;
+        }
+        remainingCycles -= slice;
+        criticalStart -= slice;
+        inputOutput -= slice;
+        used = slice;
+        if (!critical) {
+            return used;
+        }
+        Trace.record(logInfo, traceCritical, Processes, h);
+        criticalLeft = Processes.criticalLength[h] > 0 ? Processes.criticalLength[h] : 0;
+        if (criticalLeft > 0 && !Locks.tryAcquire(h, start + used)) { // the lock is full, the critical section runs once it is handed over
+            Processes.pState[h] = blocked;
+            return used;
+        }
+    }
+
+    int length = criticalLeft; // the rest of the critical section runs without being switched out
+    if (inputOutput >= 1 && inputOutput <= length) { // io inside the critical section
+        length = inputOutput;
+        remainingCycles -= length;
+        criticalLeft -= length;
+        inputOutput = 0;
+        Processes.criticalCycles[h] += length;
+        ioInterrupt(h);
+        return used + length;
+    }
+    remainingCycles -= length;
+    inputOutput -= length;
+    criticalLeft = 0;
+    Processes.criticalCycles[h] += length;
+    return used + length;
+}
+
+// simulated time the next process becomes ready by finishing io, waking up or arriving, LLONG_MAX if none will
+long long Simulation::nextEvent() {
+    return min(Disk.nextCompletion(), min(Sleepers.nextAt.load(), Arrivals.nextAt.load()));
+}
+
+// true if process h may run on cpu, an affinity without any CPU of the run lets it run anywhere
+bool Simulation::allowedOn(int cpu, int h) {
+    uint64_t mask = Processes.affinity[h] & runMask;
+    return mask == 0 || (cpu < 64 && (mask >> cpu & 1));
+}
+
+// CPU whose run queue process h goes to: preferred if it may run there, else the CPU it last ran on
+// or the first one its affinity allows
+int Simulation::homeCPU(int h, int preferred) {
+    if (allowedOn(preferred, h)) {
+        return preferred;
+    }
+    int last = Processes.lastCPU[h];
+    if (last >= 0 && last < (int) runQueues.size() && allowedOn(last, h)) {
+        return last;
+    }
+    return __builtin_ctzll(Processes.affinity[h] & runMask);
+}
+
+// cycles process h stalls for if cpu dispatches it at simulated time clock, 0 unless its cache is
+// still warm on another CPU
+int Simulation::migrationCost(int cpu, int h, long long clock) {
+    int from = Processes.lastCPU[h];
+    if (from < 0 || from == cpu || clock - Processes.lastRanAt[h] >= topology.warmth) {
+        return 0;
+    }
+    return topology.migrationCost[topology.distance(from, cpu)];
+}
+
+// takes the next process from the CPU's own queue that may run on it, the ones that may not are
+// passed on to a CPU they may run on
+template <class Queue>
+bool Simulation::popAllowed(int cpu, Queue &own, int &next) {
+    while (own.pop(next)) {
+        if (allowedOn(cpu, next)) {
+            return true;
+        }
+        runQueue<Queue>(homeCPU(next, cpu)).push(next);
+    }
+    return false;
+}
+
+// Finds the next process for a CPU whose simulated time is clock: finished io, woken sleepers and new
+// arrivals first, then its own run queue, then stealing from the other CPUs in stealOrder. If
+// everything left is waiting on io, asleep or has not arrived yet the CPU idles until the next of
+// those events. Returns false when there was nothing to run this time around.
+template <class Queue>
+bool Simulation::nextProcess(int cpu, long long &clock, int &next) {
+    Queue &own = runQueue<Queue>(cpu);
+    Disk.complete(clock, own);
+    Sleepers.wake(clock, own);
+    Arrivals.admit(clock, own);
+    if (popAllowed(cpu, own, next)) {
+        return true;
+    }
+    long long now = clock;
+    auto worth = [this, cpu, now](int h, int queued) { // the aware balancer moves a process when its queue would hold it up longer than moving costs
+        return allowedOn(cpu, h) && (!topology.aware || (long long) queued * quantum >= migrationCost(cpu, h, now));
+    };
+    for (int victim : stealOrder[cpu]) {
+        if (runQueue<Queue>(victim).steal(next, worth)) {
+            return true;
+        }
+    }
+    long long wake = nextEvent();
+    if (wake != LLONG_MAX && !Arrivals.behind(wake)) { // CPU sits idle until the io finishes, a process wakes up or the next one arrives
+        clock = max(clock, wake);
+        Disk.complete(clock, own);
+        Sleepers.wake(clock, own);
+        Arrivals.admit(clock, own);
+        return popAllowed(cpu, own, next);
+    }
+    return false;
+}
+
+// Puts a process on a CPU. The CPU clock can't be earlier than the time the process became ready,
+// and the gap between the two is time the process spent waiting in a run queue.
+void Simulation::startDispatch(CPUCounters &own, int current, long long &clock) {
+    clock = max(clock, Processes.readyAt[current]);
+    Processes.waitingTime[current] += clock - Processes.readyAt[current];
+    if (Processes.firstRun[current] < 0) {
+        Processes.firstRun[current] = clock;
+    }
+    if (own.lastProcess != current) {
+        own.contextSwitches++;
+        own.lastProcess = current;
+        Processes.switches[current]++;
+    }
+    own.dispatches++;
+    Processes.pState[current] = running; // the current process is now running
+}
+
+// Records how a dispatch that started at start went in the schedule trace: the critical section it ran
+// at the end of its burst, the pages it moved and the way it left the CPU at end.
+void Simulation::recordBurst(int cpu, int h, long long start, int used, int critical, int pagesIn, int pagesOut, long long end) {
+    int pid = Processes.pid[h];
+    if (critical > 0) {
+        Schedule.record(cpu, start + used - critical, scheduleCriticalEnter, pid, Processes.lockId[h]);
+        Schedule.record(cpu, start + used, scheduleCriticalExit, pid, Processes.criticalLeft[h]);
+    }
+    if (pagesIn > 0) {
+        Schedule.record(cpu, start + used, schedulePagesIn, pid, pagesIn);
+    }
+    if (pagesOut > 0) {
+        Schedule.record(cpu, start + used, schedulePagesOut, pid, pagesOut);
+    }
+    int ending = schedulePreempt;
+    if (Processes.pState[h] == waiting) {
+        ending = scheduleIO;
+    } else if (Processes.pState[h] == blocked) {
+        ending = scheduleLockWait;
+    } else if (Processes.pState[h] == sleeping) {
+        ending = scheduleSleep;
+    } else if (Processes.remainingCycles[h] < 0) {
+        ending = scheduleTerminate;
+    }
+    Schedule.record(cpu, end, ending, pid, used);
+}
+
+// Hands a process back after its dispatch: park it on the io device, terminate it or put it back
+// in this CPU's run queue.
+template <class Queue>
+void Simulation::finishDispatch(Queue &own, int current, long long clock) {
+    if (Processes.lockedAt[current] >= 0 && Processes.criticalLeft[current] == 0) { // left its critical section
+        int next = Locks.release(current, clock);
+        if (next >= 0) { // the first waiter gets the lock and runs its critical section next time it is dispatched
+            Processes.pState[next] = ready;
+            Processes.readyAt[next] = clock;
+            Trace.record(logInfo, traceLockHandoff, Processes, next, Processes.lockId[next]);
+            own.push(next);
+        }
+    }
+    if (Processes.pState[current] == blocked) { // the CPU moves on while the process waits for its lock
+        Trace.record(logInfo, traceLockWait, Processes, current, Processes.lockId[current]);
+        if (!Locks.wait(current, clock)) {
+            Processes.pState[current] = ready;
+            Processes.readyAt[current] = clock;
+            own.push(current);
+        }
+    } else if (Processes.pState[current] == waiting) { // the process blocked on io and the CPU moves on right away
+        Disk.request(current, clock);
+    } else if (Processes.pState[current] == sleeping) { // the timing wheel wakes it once a CPU clock reaches the end of its sleep
+        int length = Processes.stepLeft[current];
+        Processes.stepLeft[current] = 0; // before another CPU can wake it
+        Sleepers.sleep(current, clock + length);
+    } else if (Processes.remainingCycles[current] < 0) { // checks if the process has finished
+        mtx.lock();
+        MainMemory.removeProcess(current); // removes a process from the memory when it is being terminated
+        mtx.unlock();
+        Trace.record(logInfo, traceFinish, Processes, current);
+        Processes.pState[current] = terminated; // sets the processes state to terminated
+        Processes.completion[current] = clock;
+        own.turnaround.push_back(clock - Processes.arrival[current]);
+        own.waitingTimes.push_back(Processes.waitingTime[current]);
+        own.response.push_back(Processes.firstRun[current] - Processes.arrival[current]);
+        own.turnaroundHistogram.record(clock - Processes.arrival[current]);
+        own.responseHistogram.record(Processes.firstRun[current] - Processes.arrival[current]);
+        own.lastCompletion = max(own.lastCompletion, clock);
+        Arrivals.release(current); // a streamed process' slot goes back to the producer
+        liveProcesses--;
+    } else {
+        Processes.pState[current] = ready; // the process is being put back into the ready queue
+        Processes.readyAt[current] = clock;
+        Trace.record(logDebug, traceRunning, Processes, current, Processes.remainingCycles[current]);
+        own.push(current); // puts the current process back in the queue to wait for its turn again
+    }
+}
+
+// Scheduler kernel shared by every policy. A policy is a small class that names its queue
+// discipline and decides the quantum of each dispatch, what to do with the cycles a process used,
+// anything it does every time around the loop, and whether a burst is cut short when another
+// process could become ready. The kernel is instantiated for each policy so all of that is
+// resolved at compile time. Each CPU gets its own policy object for per CPU state.
+// One dispatch on a CPU whose simulated time is clock, returns false if there was nothing to run.
+template <class Policy>
+bool Simulation::stepCPU(int cpu, long long &clock, Policy &policy) {
+    typedef RunQueue<typename Policy::Discipline> Queue;
+    Queue &own = runQueue<Queue>(cpu);
+    int current; // handle of the process on this CPU
+    policy.tick(cpu, own, clock);
+    if (Arrivals.behind(clock) || !nextProcess<Queue>(cpu, clock, current)) { // the other CPUs hold every process or the producer is behind
+        return false;
+    }
+    startDispatch(own, current, clock);
+    int migration = migrationCost(cpu, current, clock); // the CPU stalls while the process' cache lines move over
+    if (migration > 0) {
+        own.migrations++;
+        own.migrationCycles += migration;
+        Processes.migrations[current]++;
+    }
+    Processes.lastCPU[current] = cpu;
+    if (Schedule.recording) {
+        if (Processes.firstRun[current] == clock) {
+            Schedule.record(cpu, Processes.arrival[current], scheduleArrival, Processes.pid[current], Processes.nameId[current]);
+        }
+        Schedule.record(cpu, clock, scheduleDispatch, Processes.pid[current], clock - Processes.readyAt[current]);
+    }
+    int cycles = policy.quantumFor(current); // number of cycles before switching to the next process
+    if (Policy::preemptive) { // the burst ends when io finishes or a process arrives so the queue can pick again
+        long long wake = nextEvent();
+        if (wake != LLONG_MAX) {
+            cycles = (int) max(1LL, min((long long) cycles, wake - clock));
+        }
+    }
+    int from = Processes.totalCycles[current] - Processes.remainingCycles[current]; // cycles the process had run
+    int critical = Schedule.recording ? Processes.criticalCycles[current] : 0;
+    int used = runBurst(current, cycles, clock); // runs the process on the CPU until its next scheduling event
+    mtx.lock(); // locks when the thread is going to access the memory
+    int resident = MainMemory.memoryUsage;
+    long long evictions = MainMemory.evictions;
+    int faults = MainMemory.dispatch(cpu, current, from, used); // swaps the process in if needed, then every cycle of the burst accesses memory
+    int pagesOut = MainMemory.evictions - evictions;
+    int pagesIn = MainMemory.memoryUsage - resident + pagesOut;
+    mtx.unlock(); // unlocks after the thread has accessed the memory
+    long long start = clock;
+    clock += used + (long long) faults * MainMemory.faultCycles + migration; // the CPU stalls while a faulted page is read in and the cache warms up
+    Processes.lastRanAt[current] = clock;
+    if (Schedule.recording) {
+        recordBurst(cpu, current, start, used, Processes.criticalCycles[current] - critical, pagesIn, pagesOut, clock);
+    }
+    own.busyCycles += used;
+    policy.charge(current, used);
+    finishDispatch(own, current, clock);
+    return true;
+}
+
+// A CPU worker thread, runs dispatches until every process has terminated
+template <class Policy>
+void Simulation::runCPU(int cpu) {
+    Policy policy(*this);
+    long long &clock = clocks[cpu]; // simulated time on this CPU in cycles
+    while ((liveProcesses > 0 || Arrivals.producing) && clock < stopClock) {
+        if (!stepCPU(cpu, clock, policy)) {
+            this_thread::yield();
+        }
+    }
+    workerAllocations += threadAllocations; // a new thread's count starts at 0
+}
+
+// Runs every CPU on the calling thread. The CPU with the earliest clock always makes the next
+// dispatch, so the run only depends on the workload and the settings and never on how the host
+// schedules threads. A CPU with nothing to run waits for the next CPU's clock to catch up with, or
+// idles a cycle when the others are at the same time so they get their turn.
+template <class Policy>
+void Simulation::runInterleaved(int cpus) {
+    vector<Policy> policies;
+    for (int i = 0; i < cpus; i++) {
+        policies.push_back(Policy(*this));
+    }
+    while (liveProcesses > 0 || Arrivals.producing) {
+        int cpu = 0;
+        for (int i = 1; i < cpus; i++) {
+            if (clocks[i] < clocks[cpu]) {
+                cpu = i;
+            }
+        }
+        if (clocks[cpu] >= stopClock) { // every CPU has reached the stop
+            break;
+        }
+        if (stepCPU(cpu, clocks[cpu], policies[cpu])) {
+            continue;
+        }
+        long long later = LLONG_MAX;
+        bool tied = false; // another CPU at the same time may still run what this one would not steal
+        for (int i = 0; i < cpus; i++) {
+            if (clocks[i] > clocks[cpu]) {
+                later = min(later, clocks[i]);
+            }
+            tied = tied || (i != cpu && clocks[i] == clocks[cpu]);
+        }
+        if (later == LLONG_MAX && tied) {
+            later = clocks[cpu] + 1;
+        }
+        if (later != LLONG_MAX && !Arrivals.behind(clocks[cpu])) {
+            clocks[cpu] = later;
+        } else { // only a producer can hand this CPU more work
+            this_thread::yield();
+        }
+    }
+}
+
+// Round robin: fifo order and the same quantum for everyone.
+class RoundRobinPolicy {
+    public:
+        typedef LevelQueue Discipline;
+        static const bool preemptive = false;
+        Simulation &sim;
+
+        RoundRobinPolicy(Simulation &simulation) : sim(simulation) {}
+
+        template <class Queue>
+        void tick(int, Queue &, long long) {}
+
+        int quantumFor(int) {
+            return sim.quantum;
+        }
+
+        void charge(int, int) {}
+};
+
+// Priority round robin: fifo order, higher priorities get 5 more cycles per level. A process with a
+// priority outside 0 to 2 gets the quantum of the process this CPU ran before it.
+class PriorityPolicy : public RoundRobinPolicy {
+    public:
+        using RoundRobinPolicy::RoundRobinPolicy;
+        int runningCycles = sim.quantum;
+
+        int quantumFor(int h) {
+            int priority = sim.Processes.priority[h];
+            int quantum = sim.quantum;
+            if (priority == 0) { // low priority
+                runningCycles = quantum;
+            } else if (priority == 1) { // medium priority
+                runningCycles = quantum + 5;
+            } else if (priority == 2) { // high priority
+                runningCycles = quantum + 10;
+            }
+            return runningCycles;
+        }
+};
+
+// Multilevel feedback queue. Every process starts on level 0 and the quantum doubles on each level
+// down. A process that has run for a whole quantum's worth of cycles on its level, over one dispatch
+// or several cut short by io, drops a level, so CPU bound processes sink and processes that block on
+// io early stay on top where they get the CPU first. Every boostPeriod cycles of its clock a CPU moves
+// everything in its run queue back to level 0 so long jobs still run.
+class FeedbackPolicy {
+    public:
+        typedef LevelQueue Discipline;
+        static const bool preemptive = false;
+        Simulation &sim;
+
+        FeedbackPolicy(Simulation &simulation) : sim(simulation) {}
+
+        // the time of the next boost is kept in sim.boosts so a stopped run boosts when it would have
+        template <class Queue>
+        void tick(int cpu, Queue &own, long long clock) {
+            long long &nextBoost = sim.boosts[cpu];
+            if (clock >= nextBoost) {
+                own.queueLock.lock();
+                own.queued.boost();
+                own.queueLock.unlock();
+                nextBoost = (clock / sim.boostPeriod + 1) * sim.boostPeriod;
+            }
+        }
+
+        int quantumFor(int h) {
+            return (sim.quantum << sim.Processes.level[h]) - sim.Processes.levelUsed[h];
+        }
+
+        void charge(int h, int used) {
+            ProcessTable &processes = sim.Processes;
+            int level = processes.level[h];
+            processes.levelUsed[h] += used;
+            if (processes.levelUsed[h] >= sim.quantum << level) { // used up its time on this level
+                processes.level[h] = min(level + 1, runLevels - 1);
+                processes.levelUsed[h] = 0;
+            }
+        }
+};
+
+// Fair share scheduler. Every process collects virtual runtime as it runs, its real cycles scaled
+// down by a weight that grows with its priority, and each CPU always runs the queued process with
+// the least virtual runtime. Higher priority processes get proportionally more of the CPU, and a
+// process that has been waiting falls behind the others in virtual time and gets picked next.
+const int fairWeights[] = { 1024, 1280, 1600 }; // weight of priority 0, 1 and 2, 25% more per level
+
+class FairPolicy : public RoundRobinPolicy {
+    public:
+        typedef VruntimeQueue Discipline;
+        using RoundRobinPolicy::RoundRobinPolicy;
+
+        void charge(int h, int used) { // charged before the process is queued again
+            int weight = fairWeights[max(0, min((int) sim.Processes.priority[h], 2))];
+            sim.Processes.vruntime[h] += (long long) used * fairWeights[0] / weight;
+        }
+};
+
+// Shortest remaining time first: the process with the fewest cycles left runs until it finishes or
+// blocks, and is preempted whenever io completes or a process arrives so a shorter one can take over.
+class ShortestRemainingPolicy : public RoundRobinPolicy {
+    public:
+        typedef RemainingQueue Discipline;
+        static const bool preemptive = true;
+        using RoundRobinPolicy::RoundRobinPolicy;
+
+        int quantumFor(int h) {
+            return max(1, sim.Processes.remainingCycles[h] + 1); // a process finishes when its count drops below 0
+        }
+};
+
+// What a scheduler run achieved. Times are in simulated cycles measured from each process' arrival.
+struct RunSummary {
+    int processes = 0; // processes that ran to completion
+    int cpus = 0;
+    long long dispatches = 0;
+    long long contextSwitches = 0;
+    long long makespan = 0; // simulated time the last process finished
+    double seconds = 0; // wall clock time of the run
+    double throughput = 0; // processes finished per 1000 simulated cycles
+    double meanTurnaround = 0, p99Turnaround = 0;
+    double meanWaiting = 0, p99Waiting = 0;
+    double meanResponse = 0, p99Response = 0;
+    double fairness = 0; // Jain's index of the share of each process' time not spent waiting, 1 is perfectly even
+    long long memoryHits = 0, memoryMisses = 0, memoryEvictions = 0; // memory counters when the run ended
+    long long memoryAccesses = 0, tlbMisses = 0, pageFaults = 0;
+    double utilization = 0; // share of the CPUs' time until the makespan spent running processes
+    long long lockAcquisitions = 0, lockContended = 0, lockWaitCycles = 0; // summed over every lock
+    long long migrations = 0, migrationCycles = 0; // dispatches that moved a warm process and the cycles they stalled
+    LatencyHistogram turnaroundHistogram, responseHistogram;
+    double dispatchRate = 0; // dispatches per wall clock second
+    long long allocations = 0; // heap allocations made while the CPUs ran
+};
+
+// nearest rank percentile, reorders values
+double percentile(vector<long long> &values, double fraction) {
+    if (values.empty()) {
+        return 0;
+    }
+    size_t rank = (size_t) (fraction * values.size() + 0.999999);
+    rank = rank == 0 ? 0 : min(rank - 1, values.size() - 1);
+    nth_element(values.begin(), values.begin() + rank, values.end());
+    return values[rank];
+}
+
+double mean(vector<long long> &values) {
+    if (values.empty()) {
+        return 0;
+    }
+    double total = 0;
+    for (long long v : values) {
+        total += v;
+    }
+    return total / values.size();
+}
+
+// Jain's fairness index (sum x)^2 / (n * sum x^2) of x = 1 - waiting / turnaround over the processes
+double fairness(vector<long long> &turnaround, vector<long long> &waitingTimes) {
+    double total = 0, squares = 0;
+    int n = 0;
+    for (size_t i = 0; i < turnaround.size(); i++) {
+        if (turnaround[i] > 0) {
+            double x = 1.0 - (double) waitingTimes[i] / turnaround[i];
+            total += x;
+            squares += x * x;
+            n++;
+        }
+    }
+    return squares > 0 ? total * total / (n * squares) : 1;
+}
+
+// Spreads the ready queue over one run queue per CPU, runs a worker thread per CPU until every
+// process has terminated and sums up the run. Processes that arrive after cycle 0 wait in Arrivals.
+// With a producer the run is streamed: the producer gets activeLimit table slots to fill while the
+// workers run, and the slots are dropped from the table again afterwards.
+template <class Policy>
+RunSummary Simulation::runSchedulers(int cpus, function<void()> producer, int activeLimit) {
+    typedef RunQueue<typename Policy::Discipline> Queue;
+    bool resuming = paused.active && !producer;
+    if (resuming) { // a stopped run carries on with the CPUs it had
+        cpus = paused.clocks.size();
+    }
+    runQueues.clear();
+    for (int i = 0; i < cpus; i++) {
+        runQueues.push_back(unique_ptr<CPUCounters>(new Queue(Processes)));
+    }
+    runMask = cpus >= 64 ? ~0ULL : (1ULL << cpus) - 1;
+    stealOrder.assign(cpus, vector<int>());
+    for (int cpu = 0; cpu < cpus; cpu++) { // the next CPU over first, the aware balancer tries the nearest ones before that
+        for (int i = 1; i < cpus; i++) {
+            stealOrder[cpu].push_back((cpu + i) % cpus);
+        }
+        if (topology.aware) {
+            stable_sort(stealOrder[cpu].begin(), stealOrder[cpu].end(),
+                [this, cpu](int a, int b) { return topology.distance(cpu, a) < topology.distance(cpu, b); });
+        }
+    }
+    if (resuming) {
+        for (int i = 0; i < cpus; i++) {
+            static_cast<CPUCounters &>(runQueue<Queue>(i)) = paused.counters[i];
+            for (int h : paused.queued[i]) {
+                runQueue<Queue>(i).push(h);
+            }
+        }
+        clocks = paused.clocks;
+        boosts = paused.boosts;
+        if ((int) MainMemory.tlbs.size() != cpus) {
+            MainMemory.useCPUs(cpus);
+        }
+    } else {
+        Arrivals.clear();
+        Sleepers.clear();
+        Locks.reset();
+        MainMemory.useCPUs(cpus);
+        lastRun.clear();
+        clocks.assign(cpus, 0);
+        boosts.assign(cpus, boostPeriod);
+        liveProcesses = 0;
+        Disk.clear(); // every CPU clock starts over at 0, and the requests of a stopped run go with it
+    }
+    // a resumed run that is already past stopAt runs to the end
+    long long reached = resuming ? *max_element(clocks.begin(), clocks.end()) : 0;
+    paused = PausedRun();
+    stopClock = stopAt > reached && !producer ? stopAt : LLONG_MAX;
+    int queued = 0; // processes in the ready queue
+    while (!readyQueue.empty()) {
+        int h = readyQueue.front();
+        readyQueue.pop();
+        lastRun.push_back(h);
+        Processes.readyAt[h] = Processes.arrival[h];
+        if (Processes.arrival[h] > 0) {
+            Arrivals.push(h);
+        } else {
+            runQueue<Queue>(homeCPU(h, queued % cpus)).push(h);
+        }
+        queued++;
+    }
+    liveProcesses += queued;
+    for (int i = 0; i < cpus; i++) { // room for an even share of the run, so the CPUs don't allocate as they go
+        runQueue<Queue>(i).reserve(liveProcesses / cpus + 1);
+    }
+    if (!schedulePath.empty()) {
+        Schedule.open(schedulePath, cpus);
+    }
+
+    if (producer) {
+        Arrivals.useSlots(Processes.grow(max(1, activeLimit)), max(1, activeLimit));
+        Arrivals.producing = true;
+    }
+    workerAllocations = 0;
+    long long allocationsBefore = threadAllocations;
+    auto start = chrono::steady_clock::now();
+    thread producerThread;
+    if (producer) {
+        producerThread = thread([this, &producer] {
+            producer();
+            workerAllocations += threadAllocations;
+        });
+    }
+    if (interleaved) {
+        runInterleaved<Policy>(cpus);
+    } else {
+        vector<thread> workers;
+        for (int i = 0; i < cpus; i++) {
+            workers.push_back(thread(&Simulation::runCPU<Policy>, this, i));
+        }
+        for (thread &worker : workers) {
+            worker.join();
+        }
+    }
+    if (producer) {
+        producerThread.join();
+    }
+    long long allocations = threadAllocations - allocationsBefore + workerAllocations;
+    if (Schedule.recording && !Schedule.close()) {
+        cerr << "\nCould not write all of " << schedulePath << "\n";
+    }
+    RunSummary summary;
+    summary.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    Trace.flush(); // the trace is finished before the summary is printed
+    if (producer) {
+        Processes.truncate(Arrivals.firstSlot); // streamed processes are gone once they terminate
+    }
+    if (liveProcesses > 0) { // stopped at stopAt, kept so the next run or a checkpoint can carry on
+        paused.active = true;
+        paused.clocks = clocks;
+        paused.boosts = boosts;
+        paused.queued.resize(cpus);
+        for (int i = 0; i < cpus; i++) {
+            Queue &q = runQueue<Queue>(i);
+            for (int h; q.pop(h);) {
+                paused.queued[i].push_back(h);
+            }
+            paused.counters.push_back(q);
+        }
+    }
+
+    summary.cpus = cpus;
+    summary.allocations = allocations;
+    long long busy = 0; // cycles the CPUs spent running processes
+    vector<long long> turnaround, waitingTimes, response;
+    for (int i = 0; i < cpus; i++) {
+        Queue &q = runQueue<Queue>(i);
+        summary.dispatches += q.dispatches;
+        summary.contextSwitches += q.contextSwitches;
+        summary.migrations += q.migrations;
+        summary.migrationCycles += q.migrationCycles;
+        busy += q.busyCycles;
+        summary.turnaroundHistogram.add(q.turnaroundHistogram);
+        summary.responseHistogram.add(q.responseHistogram);
+        summary.makespan = max(summary.makespan, q.lastCompletion);
+        turnaround.insert(turnaround.end(), q.turnaround.begin(), q.turnaround.end());
+        waitingTimes.insert(waitingTimes.end(), q.waitingTimes.begin(), q.waitingTimes.end());
+        response.insert(response.end(), q.response.begin(), q.response.end());
+    }
+    summary.processes = turnaround.size();
+    summary.throughput = summary.makespan > 0 ? 1000.0 * summary.processes / summary.makespan : 0;
+    summary.utilization = summary.makespan > 0 ? (double) busy / ((double) cpus * summary.makespan) : 0;
+    summary.fairness = fairness(turnaround, waitingTimes);
+    summary.meanTurnaround = mean(turnaround);
+    summary.p99Turnaround = percentile(turnaround, 0.99);
+    summary.meanWaiting = mean(waitingTimes);
+    summary.p99Waiting = percentile(waitingTimes, 0.99);
+    summary.meanResponse = mean(response);
+    summary.p99Response = percentile(response, 0.99);
+    for (LockTable::SimulatedLock &lock : Locks.locks) {
+        summary.lockAcquisitions += lock.acquisitions;
+        summary.lockContended += lock.contended;
+        summary.lockWaitCycles += lock.waitCycles;
+    }
+    summary.memoryHits = MainMemory.hits;
+    summary.memoryMisses = MainMemory.misses;
+    summary.memoryEvictions = MainMemory.evictions;
+    summary.memoryAccesses = MainMemory.accesses;
+    summary.tlbMisses = MainMemory.tlbMisses;
+    summary.pageFaults = MainMemory.pageFaults;
+    summary.dispatchRate = summary.seconds > 0 ? summary.dispatches / summary.seconds : 0;
+    if (!metricsPath.empty()) {
+        writeMetrics(summary, metricsPath);
+    }
+    return summary;
+}
+
+typedef RunSummary (Simulation::*Scheduler)(int cpus, function<void()> producer, int activeLimit); // runSchedulers for one policy
+
+// scheduler for a name given on the command line, nullptr if there is none by that name
+Scheduler schedulerNamed(const string &name) {
+    if (name == "round") {
+        return &Simulation::runSchedulers<RoundRobinPolicy>;
+    } else if (name == "priority") {
+        return &Simulation::runSchedulers<PriorityPolicy>;
+    } else if (name == "mlfq") {
+        return &Simulation::runSchedulers<FeedbackPolicy>;
+    } else if (name == "fair") {
+        return &Simulation::runSchedulers<FairPolicy>;
+    } else if (name == "srtf") {
+        return &Simulation::runSchedulers<ShortestRemainingPolicy>;
+    }
+    return nullptr;
+}
+
+// csv columns of printSummaryFields, the wall clock ones are left to the caller
+const char *summaryColumns = "processes,cpus,dispatches,context_switches,makespan,throughput_per_kcycle,turnaround_mean,turnaround_p99,"
+    "waiting_mean,waiting_p99,response_mean,response_p99,fairness,utilization,lock_acquisitions,lock_contended,lock_wait_cycles,"
+    "memory_hits,memory_misses,memory_evictions,memory_accesses,tlb_misses,page_faults,migrations,migration_cycles";
+
+// writes the simulated results of a run as json members or csv values, then the wall clock ones if wallTime is set
+void printSummaryFields(ostream &out, RunSummary &s, const string &format, bool wallTime) {
+    if (format == "json") {
+        out << "\"processes\":" << s.processes << ",\"cpus\":" << s.cpus << ",\"dispatches\":" << s.dispatches
+             << ",\"context_switches\":" << s.contextSwitches << ",\"makespan\":" << s.makespan
+             << ",\"throughput_per_kcycle\":" << s.throughput
+             << ",\"turnaround_mean\":" << s.meanTurnaround << ",\"turnaround_p99\":" << s.p99Turnaround
+             << ",\"waiting_mean\":" << s.meanWaiting << ",\"waiting_p99\":" << s.p99Waiting
+             << ",\"response_mean\":" << s.meanResponse << ",\"response_p99\":" << s.p99Response << ",\"fairness\":" << s.fairness
+             << ",\"utilization\":" << s.utilization << ",\"lock_acquisitions\":" << s.lockAcquisitions
+             << ",\"lock_contended\":" << s.lockContended << ",\"lock_wait_cycles\":" << s.lockWaitCycles
+             << ",\"memory_hits\":" << s.memoryHits << ",\"memory_misses\":" << s.memoryMisses
+             << ",\"memory_evictions\":" << s.memoryEvictions << ",\"memory_accesses\":" << s.memoryAccesses
+             << ",\"tlb_misses\":" << s.tlbMisses << ",\"page_faults\":" << s.pageFaults
+             << ",\"migrations\":" << s.migrations << ",\"migration_cycles\":" << s.migrationCycles;
+        if (wallTime) {
+            out << ",\"wall_seconds\":" << s.seconds << ",\"dispatches_per_sec\":" << s.dispatchRate << ",\"heap_allocations\":" << s.allocations;
+        }
+    } else {
+        out << s.processes << "," << s.cpus << "," << s.dispatches << "," << s.contextSwitches << "," << s.makespan << ","
+             << s.throughput << "," << s.meanTurnaround << "," << s.p99Turnaround << "," << s.meanWaiting << "," << s.p99Waiting << ","
+             << s.meanResponse << "," << s.p99Response << "," << s.fairness << "," << s.utilization << ","
+            << s.lockAcquisitions << "," << s.lockContended << "," << s.lockWaitCycles << "," << s.memoryHits << "," << s.memoryMisses << ","
+             << s.memoryEvictions << "," << s.memoryAccesses << "," << s.tlbMisses << "," << s.pageFaults << ","
+             << s.migrations << "," << s.migrationCycles;
+        if (wallTime) {
+            out << "," << s.seconds << "," << s.dispatchRate << "," << s.allocations;
+        }
+    }
+}
+
+// format is "text" for people, "json" for one object per run or "csv" for a header and a row
+void Simulation::printSummary(RunSummary &s, const string &format) {
+    if (format == "json") {
+        cout << "{";
+        printSummaryFields(cout, s, format, true);
+        cout << "}\n";
+    } else if (format == "csv") {
+        cout << summaryColumns << ",wall_seconds,dispatches_per_sec,heap_allocations\n";
+        printSummaryFields(cout, s, format, true);
+        cout << "\n";
+    } else {
+        cout << "\n" << s.cpus << " CPUs ran " << s.processes << " processes: " << s.dispatches << " dispatches in " << s.seconds << "s (" << s.dispatchRate << " dispatches/s, "
+             << s.allocations << " heap allocations)";
+        cout << "\nFinished in " << s.makespan << " cycles with " << s.contextSwitches << " context switches";
+        cout << "\nTurnaround mean " << s.meanTurnaround << " p99 " << s.p99Turnaround;
+        cout << ", waiting mean " << s.meanWaiting << " p99 " << s.p99Waiting;
+        cout << ", response mean " << s.meanResponse << " p99 " << s.p99Response;
+        cout << "\nFairness " << s.fairness << ", CPU utilization " << 100 * s.utilization << "%";
+        cout << "\nLocks: " << s.lockAcquisitions << " acquisitions, " << s.lockContended << " contended, "
+             << s.lockWaitCycles << " cycles blocked";
+        cout << "\nMigrations: " << s.migrations << " warm processes moved, stalling the CPUs " << s.migrationCycles << " cycles";
+        MainMemory.printStats();
+        if (paused.active) {
+            cout << "\nStopped at cycle " << stopAt << " with " << liveProcesses << " processes left, run again to carry on";
+        }
+    }
+}
+
+// name as a json string
+string jsonString(const string &text) {
+    string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+        }
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+// name as a csv field, quoted when it holds a comma or a quote
+string csvField(const string &text) {
+    if (text.find_first_of(",\"") == string::npos) {
+        return text;
+    }
+    string quoted = "\"";
+    for (char c : text) {
+        if (c == '"') {
+            quoted += '"';
+        }
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+// percentiles and non empty buckets of a histogram as a json object
+void printHistogram(ostream &out, const LatencyHistogram &histogram) {
+    out << "{\"count\":" << histogram.total << ",\"max\":" << histogram.maxValue << ",\"p50\":" << histogram.percentile(0.5)
+        << ",\"p90\":" << histogram.percentile(0.9) << ",\"p99\":" << histogram.percentile(0.99)
+        << ",\"p999\":" << histogram.percentile(0.999) << ",\"buckets\":[";
+    bool first = true;
+    for (int i = 0; i < LatencyHistogram::bucketCount; i++) {
+        if (histogram.counts[i] > 0) {
+            out << (first ? "" : ",") << "[" << LatencyHistogram::lowest(i) << "," << LatencyHistogram::highest(i) << "," << histogram.counts[i] << "]";
+            first = false;
+        }
+    }
+    out << "]}";
+}
+
+// Writes what the last run recorded to path. A path ending in .json gets one object with the summary,
+// the turnaround and response histograms and a row per process. Any other path gets the process rows
+// as csv, and the histogram buckets go to the same name with -histograms.csv in place of .csv.
+// Processes that were streamed in are not in the table any more, only the histograms count them.
+bool Simulation::writeMetrics(RunSummary &s, const string &path) {
+    bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    ofstream out(path, ios::trunc);
+    if (!out.is_open()) {
+        cerr << "\nCould not write " << path << "\n";
+        return false;
+    }
+    if (json) {
+        out << "{\"summary\":{";
+        printSummaryFields(out, s, "json", true);
+        out << "},\"turnaround\":";
+        printHistogram(out, s.turnaroundHistogram);
+        out << ",\"response\":";
+        printHistogram(out, s.responseHistogram);
+        out << ",\"processes\":[";
+    } else {
+        out << "pid,name,priority,arrival,first_run,completion,turnaround,response,waiting,context_switches,critical_cycles,io_waits,io_wait_cycles,migrations\n";
+    }
+    bool first = true;
+    for (int h : lastRun) {
+        if (Processes.completion[h] < 0) { // did not finish in this run
+            continue;
+        }
+        long long turnaround = Processes.completion[h] - Processes.arrival[h];
+        long long response = Processes.firstRun[h] - Processes.arrival[h];
+        const string &name = Names.name(Processes.nameId[h]);
+        if (json) {
+            out << (first ? "" : ",") << "\n{\"pid\":" << Processes.pid[h] << ",\"name\":" << jsonString(name)
+                << ",\"priority\":" << (int) Processes.priority[h] << ",\"arrival\":" << Processes.arrival[h]
+                << ",\"first_run\":" << Processes.firstRun[h] << ",\"completion\":" << Processes.completion[h]
+                << ",\"turnaround\":" << turnaround << ",\"response\":" << response << ",\"waiting\":" << Processes.waitingTime[h]
+                << ",\"context_switches\":" << Processes.switches[h] << ",\"critical_cycles\":" << Processes.criticalCycles[h]
+                << ",\"io_waits\":" << Processes.ioWaits[h] << ",\"io_wait_cycles\":" << Processes.ioWaitCycles[h]
+                << ",\"migrations\":" << Processes.migrations[h] << "}";
+        } else {
+            out << Processes.pid[h] << "," << csvField(name) << "," << (int) Processes.priority[h] << "," << Processes.arrival[h] << ","
+                << Processes.firstRun[h] << "," << Processes.completion[h] << "," << turnaround << "," << response << ","
+                << Processes.waitingTime[h] << "," << Processes.switches[h] << "," << Processes.criticalCycles[h] << ","
+                << Processes.ioWaits[h] << "," << Processes.ioWaitCycles[h] << "," << Processes.migrations[h] << "\n";
+        }
+        first = false;
+    }
+    if (json) {
+        out << "]}\n";
+        return out.good();
+    }
+
+    string histogramPath = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0 ? path.substr(0, path.size() - 4) : path;
+    histogramPath += "-histograms.csv";
+    ofstream histograms(histogramPath, ios::trunc);
+    if (!histograms.is_open()) {
+        cerr << "\nCould not write " << histogramPath << "\n";
+        return false;
+    }
+    histograms << "metric,low,high,count\n";
+    const LatencyHistogram *both[] = { &s.turnaroundHistogram, &s.responseHistogram };
+    const char *names[] = { "turnaround", "response" };
+    for (int m = 0; m < 2; m++) {
+        for (int i = 0; i < LatencyHistogram::bucketCount; i++) {
+            if (both[m]->counts[i] > 0) {
+                histograms << names[m] << "," << LatencyHistogram::lowest(i) << "," << LatencyHistogram::highest(i) << "," << both[m]->counts[i] << "\n";
+            }
+        }
+    }
+    return out.good() && histograms.good();
+}
+
+// Runs the same workload with 1, 2, 4, ... up to maxCPUs workers to show how dispatch throughput scales.
+// Every CPU count starts from the same process state and an empty memory of the same size.
+void Simulation::scaleSchedulers(Scheduler scheduler, int maxCPUs) {
+    if (paused.active) {
+        cout << "\nA run is stopped, run it to the end before comparing CPU counts";
+        return;
+    }
+    long long stop = stopAt;
+    stopAt = 0; // each CPU count runs the whole workload
+    queue<int> workload = readyQueue;
+    ProcessTable saved = Processes; // every run starts from the same process state
+    vector<pair<int, double>> results;
+    for (int cpus = 1; cpus <= maxCPUs; cpus *= 2) {
+        readyQueue = workload;
+        Processes = saved;
+        MainMemory.resize(MainMemory.frameOwner.size(), MainMemory.policy); // no pages left over from the last CPU count
+        RunSummary summary = (this->*scheduler)(cpus, nullptr, 0);
+        printSummary(summary, "text");
+        results.push_back(make_pair(cpus, summary.dispatchRate));
+    }
+    stopAt = stop;
+    cout << "\n\nCPUs  dispatches/s";
+    for (auto &result : results) {
+        cout << "\n" << result.first << "  " << result.second;
+    }
+}
+
+
+void Simulation::addUserProcess(int numProc) {
+    int pid = numProc;
+    cout << "\nEnter the amount of cycles this process takes: ";
+    int totalCycles;
+    cin >> totalCycles;
+    cout << "\nEnter the process name: ";
+    string name;
+    cin >> name;
+    cout << "\nEnter the process' priority: ";
+    int priority;
+    cin >> priority;
+    cout << "\nEnter the start cycle for the critical section: ";
+    int criticalStart;
+    cin >> criticalStart;
+    cout << "\nEnter the length of the critical section in cycles: ";
+    int criticalLength;
+    cin >> criticalLength;
+    cout << "\nEnter the location of the inputOutput: ";
+    int inputOutput;
+    cin >> inputOutput;
+    cout << "\nCreating a process: " << name << ".";
+    JobSpec job;
+    job.name = name;
+    job.cycles = totalCycles;
+    job.priority = priority;
+    job.criticalStart = criticalStart;
+    job.criticalLength = criticalLength;
+    job.inputOutput = inputOutput;
+    int h = Processes.add(pid, job);
+    readyQueue.push(h);
+    return;
+}
+
+
+// read only memory mapping of a whole file
+class MappedFile {
+    public:
+        const char *data = "";
+        size_t size = 0;
+        void *mapping = MAP_FAILED;
+
+        bool map(const string &path) {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            struct stat info;
+            if (fd < 0 || fstat(fd, &info) != 0) {
+                cerr << "\nFile not found: " << path << "\n"; // the path did not point to a file
+                if (fd >= 0) {
+                    close(fd);
+                }
+                return false;
+            }
+            size = info.st_size;
+            if (size > 0) {
+                mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapping == MAP_FAILED) {
+                    cerr << "\nCould not map " << path << "\n";
+                    close(fd);
+                    return false;
+                }
+                madvise(mapping, size, MADV_SEQUENTIAL);
+                data = (const char *) mapping;
+            }
+            close(fd); // the mapping stays valid without the descriptor
+            return true;
+        }
+
+        ~MappedFile() {
+            if (mapping != MAP_FAILED) {
+                munmap(mapping, size);
+            }
+        }
+};
+
+// Job file loader. The file is memory mapped and tokenized in place: tokens are views into the
+// mapping, numbers are converted straight from the bytes and only process names are copied out.
+// Each process is a run of NAME/LOAD/PRIORITY/CRITICALS/CRITICALL/IO/ARRIVAL/PROGRAM lines closed by "-",
+// and the file ends at EXE. A malformed entry is reported with its line and column and nothing from
+// that file is loaded. Other words are skipped so job files can carry notes. ARRIVAL times can't go
+// back in time, and a process without one arrives with the process before it. PROGRAM names a program
+// file for the process to run, which then takes the place of LOAD.
+class JobFileParser {
+    public:
+        string path;
+        const char *pos; // next byte to read
+        const char *end;
+        const char *lineStart; // first byte of the current line, for columns
+        long long line = 1;
+        const char *tokenStart = nullptr; // start of the last token read
+        long long lastArrival = 0; // arrival time of the previous process
+        string error; // set on the first problem found
+
+        JobFileParser(const string &file, const char *data, size_t size) {
+            path = file;
+            pos = data;
+            end = data + size;
+            lineStart = data;
+        }
+
+        // reads the next whitespace separated token, false at the end of the file
+        bool next(string_view &token) {
+            while (pos < end && isspace((unsigned char) *pos)) {
+                if (*pos == '\n') {
+                    line++;
+                    lineStart = pos + 1;
+                }
+                pos++;
+            }
+            if (pos == end) {
+                return false;
+            }
+            tokenStart = pos;
+            while (pos < end && !isspace((unsigned char) *pos)) {
+                pos++;
+            }
+            token = string_view(tokenStart, pos - tokenStart);
+            return true;
+        }
+
+        // reads the number after a keyword
+        bool number(string_view keyword, long long &value, long long limit = INT_MAX) {
+            string_view token;
+            if (!next(token)) {
+                return fail(string(keyword) + " expects a number but the file ended");
+            }
+            size_t i = 0;
+            bool negative = false;
+            if (token[0] == '-' || token[0] == '+') {
+                negative = token[0] == '-';
+                i = 1;
+            }
+            if (i == token.size()) {
+                return fail(string(keyword) + " expects a number, got '" + string(token) + "'");
+            }
+            long long result = 0;
+            for (; i < token.size(); i++) {
+                if (token[i] < '0' || token[i] > '9') {
+                    return fail(string(keyword) + " expects a number, got '" + string(token) + "'");
+                }
+                result = result * 10 + (token[i] - '0');
+                if (result > limit) {
+                    return fail(string(keyword) + " value '" + string(token) + "' is too large");
+                }
+            }
+            value = negative ? -result : result;
+            return true;
+        }
+
+        bool number(string_view keyword, int &value) {
+            long long result;
+            if (!number(keyword, result)) {
+                return false;
+            }
+            value = result;
+            return true;
+        }
+
+        bool fail(const string &message) {
+            long long column = (tokenStart != nullptr && tokenStart >= lineStart ? tokenStart - lineStart : pos - lineStart) + 1;
+            error = path + ":" + to_string(line) + ":" + to_string(column) + ": " + message;
+            return false;
+        }
+
+        // reads the next process, false at EXE or on a bad entry (with error set)
+        bool nextJob(JobSpec &job) {
+            string_view token;
+            job = JobSpec(); // every process starts from the defaults
+            job.arrival = lastArrival;
+            bool open = false; // this process has entries that no "-" has closed yet
+            while (next(token)) {
+                if (token == "EXE") {
+                    if (open) {
+                        fail("process " + string(job.name) + " is missing its closing -");
+                    }
+                    return false;
+                } else if (token == "NAME") {
+                    if (!next(token)) {
+                        return fail("NAME expects a process name but the file ended");
+                    }
+                    job.name = token;
+                    open = true;
+                } else if (token == "LOAD") {
+                    if (!number(token, job.cycles)) {
+                        return false;
+                    }
+                    if (job.cycles < 0) {
+                        return fail("LOAD can't be negative");
+                    }
+                    open = true;
+                } else if (token == "PRIORITY") {
+                    if (!number(token, job.priority)) {
+                        return false;
+                    }
+                    open = true;
+                } else if (token == "CRITICALS") {
+                    if (!number(token, job.criticalStart)) {
+                        return false;
+                    }
+                    open = true;
+                } else if (token == "CRITICALL") {
+                    if (!number(token, job.criticalLength)) {
+                        return false;
+                    }
+                    open = true;
+                } else if (token == "IO") {
+                    if (!number(token, job.inputOutput)) {
+                        return false;
+                    }
+                    open = true;
+                } else if (token == "ARRIVAL") {
+                    if (!number(token, job.arrival, LLONG_MAX / 10)) {
+                        return false;
+                    }
+                    if (job.arrival < lastArrival) {
+                        return fail("ARRIVAL " + to_string(job.arrival) + " is earlier than the process before it");
+                    }
+                    open = true;
+                } else if (token == "LOCK") {
+                    if (!number(token, job.lock)) {
+                        return false;
+                    }
+                    if (job.lock < -1 || job.lock >= LockTable::maxLocks) {
+                        return fail("LOCK has to be from -1 to " + to_string(LockTable::maxLocks - 1));
+                    }
+                    open = true;
+                } else if (token == "AFFINITY") {
+                    if (!next(token)) {
+                        return fail("AFFINITY expects a list of CPUs but the file ended");
+                    }
+                    if (!parseCPUList(token, job.affinity)) {
+                        return fail("AFFINITY expects CPUs from 0 to 63 like 0,2-3, got '" + string(token) + "'");
+                    }
+                    open = true;
+                } else if (token == "PROGRAM") {
+                    if (!next(token)) {
+                        return fail("PROGRAM expects a program file but the file ended");
+                    }
+                    job.program = Programs.load(string(token));
+                    if (job.program < 0) {
+                        return fail(Programs.error);
+                    }
+                    open = true;
+                } else if (token == "-") {
+                    if (job.cycles < 0 && job.program < 0) {
+                        return fail("process " + string(job.name) + " has no LOAD");
+                    }
+                    lastArrival = job.arrival;
+                    return true;
+                }
+            }
+            tokenStart = nullptr;
+            return fail("missing EXE at the end of the file");
+        }
+
+        // parses the whole file into processes numbered from nextPid on, returns false with error set on a bad entry
+        bool parse(ProcessTable &processes, int &nextPid) {
+            JobSpec job;
+            while (nextJob(job)) {
+                processes.add(nextPid++, job);
+            }
+            return error.empty();
+        }
+};
+
+// Binary job files. A converted job file is a fixed header, one fixed width record per process and
+// a table holding each distinct name once, so loading it is a bounds check and a copy into the
+// process table with no parsing. Numbers are stored in the byte order of the machine (little endian
+// on the machines we run on). Bump binaryJobVersion whenever the layout changes. Older records are a
+// prefix of newer ones and are still read: version 1 has no arrival times, version 2 no programs and
+// version 4 no affinity.
+const char binaryJobMagic[8] = { 'O', 'P', 'S', 'I', 'M', 'J', 'O', 'B' };
+const uint32_t binaryJobVersion = 5;
+
+struct JobFileHeader {
+    char magic[8]; // binaryJobMagic
+    uint32_t version; // binaryJobVersion
+    uint32_t recordSize; // sizeof(JobRecord)
+    uint64_t processCount; // records right after the header
+    uint64_t nameCount; // names in the name table
+    uint64_t namesOffset; // byte offset of the name table, each name is a uint32 length and its bytes
+};
+
+struct JobRecord {
+    int32_t cycles;
+    int32_t priority;
+    int32_t criticalStart;
+    int32_t criticalLength;
+    int32_t inputOutput;
+    uint32_t nameId; // index into the file's name table
+    int64_t arrival; // version 2 and later
+    int32_t program; // version 3 and later, the program file's path in the name table or -1
+    int32_t lock; // version 4 and later, the critical section's lock or -1, always 0 before
+    uint64_t affinity; // version 5 and later, CPUs the process may run on or 0 for any
+};
+const uint32_t jobRecordSize[] = { 0, offsetof(JobRecord, arrival), offsetof(JobRecord, program), offsetof(JobRecord, affinity),
+    offsetof(JobRecord, affinity), sizeof(JobRecord) }; // by version
+
+bool isBinaryJobFile(const char *data, size_t size) {
+    return size >= sizeof(JobFileHeader) && memcmp(data, binaryJobMagic, sizeof(binaryJobMagic)) == 0;
+}
+
+// Checked view of a mapped binary job file
+class BinaryJobFile {
+    public:
+        JobFileHeader header;
+        const char *records = nullptr;
+        vector<string_view> names; // the file's name table
+        vector<int> programs; // id in Programs of each name used as a program path, -2 before it is compiled
+        string error;
+
+        bool open(const string &path, const char *data, size_t size) {
+            memcpy(&header, data, sizeof(header));
+            if (header.version < 1 || header.version > binaryJobVersion) {
+                error = path + ": binary job file version " + to_string(header.version) + " is not supported";
+                return false;
+            }
+            uint32_t expected = jobRecordSize[header.version];
+            if (header.recordSize != expected) {
+                error = path + ": binary job file records are " + to_string(header.recordSize) + " bytes, expected " + to_string(expected);
+                return false;
+            }
+            size_t available = (size - sizeof(header)) / header.recordSize;
+            if (header.processCount > available || header.processCount > (uint64_t) INT_MAX
+                    || header.namesOffset < sizeof(header) + header.processCount * header.recordSize || header.namesOffset > size) {
+                error = path + ": binary job file is truncated or corrupt";
+                return false;
+            }
+            names.reserve(min<uint64_t>(header.nameCount, size));
+            size_t pos = header.namesOffset;
+            for (uint64_t i = 0; i < header.nameCount; i++) {
+                uint32_t length;
+                if (size - pos < sizeof(length)) {
+                    error = path + ": binary job file name table is truncated";
+                    return false;
+                }
+                memcpy(&length, data + pos, sizeof(length));
+                pos += sizeof(length);
+                if (size - pos < length) {
+                    error = path + ": binary job file name table is truncated";
+                    return false;
+                }
+                names.push_back(string_view(data + pos, length));
+                pos += length;
+            }
+            programs.assign(names.size(), -2);
+            records = data + sizeof(header);
+            return true;
+        }
+
+        int count() {
+            return header.processCount;
+        }
+
+        // reads record i, false if it is corrupt
+        bool job(int i, JobSpec &job, uint32_t &nameId) {
+            JobRecord r;
+            r.arrival = 0;
+            r.program = -1;
+            r.lock = 0;
+            r.affinity = 0;
+            memcpy(&r, records + (size_t) i * header.recordSize, header.recordSize);
+            if (r.nameId >= names.size() || r.cycles < 0 || r.arrival < 0 || r.program < -1 || r.program >= (int) names.size()
+                || r.lock < -1 || r.lock >= LockTable::maxLocks) {
+                error = "process record " + to_string(i) + " is corrupt";
+                return false;
+            }
+            if (i > 0 && header.recordSize > offsetof(JobRecord, arrival)) { // arrivals only go up, like in a text job file
+                int64_t before;
+                memcpy(&before, records + (size_t) (i - 1) * header.recordSize + offsetof(JobRecord, arrival), sizeof(before));
+                if (r.arrival < before) {
+                    error = "ARRIVAL " + to_string(r.arrival) + " is earlier than the process before it";
+                    return false;
+                }
+            }
+            job.program = -1;
+            if (r.program >= 0) {
+                if (programs[r.program] == -2) {
+                    programs[r.program] = Programs.load(string(names[r.program]));
+                }
+                job.program = programs[r.program];
+                if (job.program < 0) {
+                    error = Programs.error;
+                    return false;
+                }
+            }
+            job.name = names[r.nameId];
+            job.cycles = r.cycles;
+            job.priority = r.priority;
+            job.criticalStart = r.criticalStart;
+            job.criticalLength = r.criticalLength;
+            job.inputOutput = r.inputOutput;
+            job.arrival = r.arrival;
+            job.lock = r.lock;
+            job.affinity = r.affinity;
+            nameId = r.nameId;
+            return true;
+        }
+};
+
+// appends the processes of a mapped binary job file to the process table
+bool Simulation::loadBinaryJobs(const string &path, const char *data, size_t size, string &error) {
+    BinaryJobFile file;
+    if (!file.open(path, data, size)) {
+        error = file.error;
+        return false;
+    }
+    if (file.count() > INT_MAX - Processes.size()) {
+        error = path + ": too many processes";
+        return false;
+    }
+    vector<int> nameIds; // file name id to id in Names, so each name is only interned once
+    for (string_view name : file.names) {
+        nameIds.push_back(Names.intern(name));
+    }
+    int count = file.count();
+    int first = Processes.grow(count);
+    JobSpec job;
+    uint32_t fileNameId;
+    for (int i = 0; i < count; i++) {
+        if (!file.job(i, job, fileNameId)) {
+            error = path + ": " + file.error;
+            return false;
+        }
+        Processes.set(first + i, numberOfProcesses + i, job, nameIds[fileNameId]);
+    }
+    numberOfProcesses += count;
+    return true;
+}
+
+// writes the processes with handles first to last - 1 as a binary job file
+bool Simulation::writeBinaryJobs(const string &path, int first, int last) {
+    ofstream file(path, ios::binary | ios::trunc);
+    if (!file.is_open()) {
+        cerr << "\nCould not write " << path << "\n";
+        return false;
+    }
+    unordered_map<int, uint32_t> fileIds; // id in Names to file name id
+    vector<int> fileNames;
+    auto fileId = [&](int id) { // process names and program paths share the file's name table
+        auto found = fileIds.find(id);
+        if (found != fileIds.end()) {
+            return found->second;
+        }
+        uint32_t nameId = fileNames.size();
+        fileIds[id] = nameId;
+        fileNames.push_back(id);
+        return nameId;
+    };
+    vector<JobRecord> records;
+    records.reserve(last - first);
+    for (int h = first; h < last; h++) {
+        int program = Processes.program[h] >= 0 ? (int) fileId(Programs.pathId[Processes.program[h]]) : -1;
+        records.push_back(JobRecord{Processes.totalCycles[h], Processes.priority[h], Processes.criticalStart[h],
+            Processes.criticalLength[h], Processes.inputOutput[h], fileId(Processes.nameId[h]), Processes.arrival[h], program, Processes.lockId[h],
+            Processes.affinity[h]});
+    }
+    JobFileHeader header;
+    memcpy(header.magic, binaryJobMagic, sizeof(header.magic));
+    header.version = binaryJobVersion;
+    header.recordSize = sizeof(JobRecord);
+    header.processCount = records.size();
+    header.nameCount = fileNames.size();
+    header.namesOffset = sizeof(header) + records.size() * sizeof(JobRecord);
+    file.write((const char *) &header, sizeof(header));
+    file.write((const char *) records.data(), records.size() * sizeof(JobRecord));
+    for (int id : fileNames) {
+        const string &name = Names.name(id);
+        uint32_t length = name.size();
+        file.write((const char *) &length, sizeof(length));
+        file.write(name.data(), length);
+    }
+    return file.good();
+}
+
+// Maps a text or binary job file and appends its processes to the process table. A bad file
+// appends nothing. Returns false if the file could not be loaded.
+bool Simulation::loadJobFile(const string &path) {
+    MappedFile file;
+    if (!file.map(path)) {
+        return false;
+    }
+    if (verbose) {
+        cout << "\n" << path << " opened";
+    }
+
+    int first = Processes.size(); // processes from this file start at this handle
+    int firstPid = numberOfProcesses;
+    bool loaded;
+    string error;
+    if (isBinaryJobFile(file.data, file.size)) {
+        loaded = loadBinaryJobs(path, file.data, file.size, error);
+    } else {
+        JobFileParser parser(path, file.data, file.size);
+        loaded = parser.parse(Processes, numberOfProcesses);
+        error = parser.error;
+    }
+    if (!loaded) { // a bad file loads nothing
+        cerr << "\n" << error << "\n";
+        Processes.truncate(first);
+        numberOfProcesses = firstPid;
+    }
+    return loaded;
+}
+
+// Creates count processes that run the program file at path, named after the file
+void Simulation::addProgram(const string &path, int count) {
+    int program = Programs.load(path);
+    if (program < 0) {
+        cerr << "\n" << Programs.error << "\n";
+        return;
+    }
+    JobSpec job;
+    size_t slash = path.find_last_of('/');
+    string name = path.substr(slash == string::npos ? 0 : slash + 1);
+    name = name.substr(0, name.find_last_of('.')); // job.name only points at it
+    job.name = name;
+    job.program = program;
+    for (int i = 0; i < count; i++) {
+        int h = Processes.add(numberOfProcesses, job);
+        numberOfProcesses++;
+        readyQueue.push(h);
+    }
+    if (verbose) {
+        cout << "\nCreated " << count << " processes running " << path << " (" << Programs.ram[program] << " MB, "
+             << Programs.cycles[program] << " cycles)";
+    }
+}
+
+void Simulation::addFile(string path) {
+    int first = Processes.size();
+    if (!loadJobFile(path)) {
+        return;
+    }
+    for (int h = first; h < Processes.size(); h++) {
+        readyQueue.push(h);
+        if (verbose) {
+            cout << "\n\nCreating Process from: " << path;
+            Processes.printProcess(h);
+        }
+    }
+    return;
+}
+
+// Converts a text job file into the binary format. The processes are only borrowed from the
+// process table for the conversion and are not queued to run.
+bool Simulation::convertJobFile(const string &textPath, const string &binaryPath) {
+    int first = Processes.size();
+    int firstPid = numberOfProcesses;
+    if (!loadJobFile(textPath)) {
+        return false;
+    }
+    int count = Processes.size() - first;
+    bool written = writeBinaryJobs(binaryPath, first, Processes.size());
+    Processes.truncate(first);
+    numberOfProcesses = firstPid;
+    if (written) {
+        cout << "\nWrote " << count << " processes to " << binaryPath;
+    }
+    return written;
+}
+
+// Producer for a streamed run: reads a text or binary job file one process at a time and hands each
+// one to the schedulers as soon as it has a table slot.
+void Simulation::streamJobFile(string path) {
+    MappedFile file;
+    if (file.map(path)) {
+        string error;
+        JobSpec job;
+        if (isBinaryJobFile(file.data, file.size)) {
+            BinaryJobFile binary;
+            uint32_t nameId;
+            if (!binary.open(path, file.data, file.size)) {
+                error = binary.error;
+            }
+            for (int i = 0; error.empty() && i < binary.count(); i++) {
+                if (binary.job(i, job, nameId)) {
+                    Arrivals.stream(job, numberOfProcesses++);
+                } else {
+                    error = path + ": " + binary.error;
+                }
+            }
+        } else {
+            JobFileParser parser(path, file.data, file.size);
+            while (parser.nextJob(job)) {
+                Arrivals.stream(job, numberOfProcesses++);
+            }
+            error = parser.error;
+        }
+        if (!error.empty()) { // what was streamed before the bad entry still runs
+            cerr << "\n" << error << "\n";
+        }
+    }
+    Arrivals.producing = false;
+}
+
+// Producer for a streamed run of generated processes with exponentially distributed gaps between
+// arrivals, an open system with on average one new process every meanGap cycles.
+void Simulation::streamGenerated(int count, double meanGap) {
+    exponential_distribution<double> gap(meanGap > 0 ? 1.0 / meanGap : 1.0);
+    double arrival = 0;
+    JobSpec job;
+    for (int i = 0; i < count; i++) {
+        workload.draw(random, job);
+        job.arrival = (long long) arrival;
+        Arrivals.stream(job, numberOfProcesses++);
+        if (meanGap > 0) {
+            arrival += gap(random);
+        }
+    }
+    Arrivals.producing = false;
+}
+
+// Checkpoint files. A checkpoint is the whole state of a simulation between runs or of a run stopped
+// at stopAt: the settings and generator, the process table, the ready queue, memory with its page
+// tables and TLBs, the io device, locks, pending arrivals and, for a stopped run, each CPU's clock,
+// counters and run queue. After a fixed header every array is its length followed by a raw copy of
+// its elements, so saving and restoring are a handful of large copies and restoring copies straight
+// out of the mapped file. Each component saves itself through checkpoint(Archive &), and the same
+// function reads it back, so the two directions can't drift apart. Names and programs are shared
+// by every simulation, so the checkpoint carries its own and restoring interns them again and
+// renumbers the processes' ids. Like binary job files the byte order is the machine's.
+const char checkpointMagic[8] = { 'O', 'P', 'S', 'I', 'M', 'C', 'K', 'P' };
+const uint32_t checkpointVersion = 6;
+
+struct CheckpointHeader {
+    char magic[8]; // checkpointMagic
+    uint32_t version; // checkpointVersion
+    uint32_t cpus; // CPUs of the stopped run, 0 if no run was stopped
+    uint64_t processCount;
+    int64_t stoppedAt; // stopAt of the stopped run
+};
+
+class CheckpointWriter {
+    public:
+        static const bool reading = false;
+        ofstream &out;
+
+        CheckpointWriter(ofstream &file) : out(file) {}
+
+        template <class T>
+        void io(T &value) {
+            static_assert(is_trivially_copyable<T>::value, "only plain values are copied into a checkpoint");
+            out.write((const char *) &value, sizeof(T));
+        }
+
+        template <class T>
+        void io(vector<T> &values) {
+            static_assert(is_trivially_copyable<T>::value, "only plain values are copied into a checkpoint");
+            uint64_t count = values.size();
+            io(count);
+            out.write((const char *) values.data(), count * sizeof(T));
+        }
+
+        void fail() {}
+};
+
+class CheckpointReader {
+    public:
+        static const bool reading = true;
+        const char *pos;
+        const char *end;
+        bool ok = true; // false once anything was truncated or out of range
+
+        CheckpointReader(const char *data, size_t size) : pos(data), end(data + size) {}
+
+        template <class T>
+        void io(T &value) {
+            if (!ok || (size_t) (end - pos) < sizeof(T)) {
+                ok = false;
+                return;
+            }
+            memcpy(&value, pos, sizeof(T));
+            pos += sizeof(T);
+        }
+
+        // a bool is one byte that has to be 0 or 1
+        void io(bool &value) {
+            unsigned char byte = 0;
+            io(byte);
+            if (byte > 1) {
+                ok = false;
+            }
+            value = byte == 1;
+        }
+
+        template <class T>
+        void io(vector<T> &values) {
+            uint64_t count = 0;
+            io(count);
+            if (!ok || count > (uint64_t) (end - pos) / sizeof(T)) {
+                ok = false;
+                values.clear();
+                return;
+            }
+            values.resize(count);
+            if (count > 0) {
+                memcpy(values.data(), pos, count * sizeof(T));
+            }
+            pos += count * sizeof(T);
+        }
+
+        void fail() {
+            ok = false;
+        }
+};
+
+// the simulation's own state, the same steps save and restore it
+template <class Archive>
+void Simulation::checkpointState(Archive &a) {
+    a.io(numberOfProcesses);
+    a.io(numberOfCPUs);
+    a.io(quantum);
+    a.io(boostPeriod);
+    a.io(interleaved);
+    topology.checkpoint(a);
+    a.io(random.state);
+    a.io(stopAt);
+    Processes.checkpoint(a);
+    vector<int> ready;
+    for (queue<int> copy = readyQueue; !copy.empty(); copy.pop()) {
+        ready.push_back(copy.front());
+    }
+    a.io(ready);
+    a.io(lastRun);
+    int live = liveProcesses;
+    a.io(live);
+    MainMemory.checkpoint(a);
+    Disk.checkpoint(a);
+    Locks.checkpoint(a);
+    Arrivals.checkpoint(a);
+    Sleepers.checkpoint(a);
+    a.io(paused.active);
+    a.io(paused.clocks);
+    a.io(paused.boosts);
+    paused.queued.resize(paused.clocks.size());
+    paused.counters.resize(paused.clocks.size());
+    for (size_t i = 0; i < paused.clocks.size(); i++) {
+        a.io(paused.queued[i]);
+        paused.counters[i].checkpoint(a);
+    }
+    if (Archive::reading) {
+        readyQueue = queue<int>();
+        for (int h : ready) {
+            readyQueue.push(h);
+        }
+        liveProcesses = live;
+        int count = Processes.size();
+        auto inTable = [count](const vector<int> &handles) {
+            return all_of(handles.begin(), handles.end(), [count](int h) { return h >= 0 && h < count; });
+        };
+        bool valid = Processes.consistent(runLevels, LockTable::maxLocks) && MainMemory.consistent(count) && inTable(ready) && inTable(lastRun)
+            && numberOfCPUs >= 1 && quantum >= 1 && quantum <= INT_MAX >> runLevels && boostPeriod >= 1 && live >= 0
+            && paused.active == !paused.clocks.empty() && paused.boosts.size() == paused.clocks.size() && topology.fits(paused.active ? paused.clocks.size() : numberOfCPUs);
+        for (vector<int> &handles : paused.queued) {
+            valid = valid && inTable(handles);
+        }
+        for (long long clock : paused.clocks) {
+            valid = valid && clock >= 0 && clock <= maxRestoredTime;
+        }
+        for (long long boost : paused.boosts) {
+            valid = valid && boost >= 1 && boost <= maxRestoredTime;
+        }
+        if (!valid) {
+            a.fail();
+        }
+    }
+}
+
+// writes the simulation to path, between runs or while a run is stopped
+bool Simulation::saveCheckpoint(const string &path) {
+    if (Arrivals.producing) {
+        cerr << "\nA streamed run can't be checkpointed\n";
+        return false;
+    }
+    ofstream file(path, ios::binary | ios::trunc);
+    if (!file.is_open()) {
+        cerr << "\nCould not write " << path << "\n";
+        return false;
+    }
+    CheckpointHeader header;
+    memcpy(header.magic, checkpointMagic, sizeof(header.magic));
+    header.version = checkpointVersion;
+    header.cpus = paused.active ? paused.clocks.size() : 0;
+    header.processCount = Processes.size();
+    header.stoppedAt = paused.active ? stopAt : 0;
+    file.write((const char *) &header, sizeof(header));
+    CheckpointWriter a(file);
+
+    vector<char> names; // every name back to back
+    vector<uint32_t> lengths;
+    Names.nameLock.lock();
+    for (int id = 0; id < Names.size(); id++) {
+        const string &name = Names.name(id);
+        names.insert(names.end(), name.begin(), name.end());
+        lengths.push_back(name.size());
+    }
+    Names.nameLock.unlock();
+    a.io(names);
+    a.io(lengths);
+    int programCount = Programs.size();
+    a.io(programCount);
+    for (int p = 0; p < programCount; p++) {
+        a.io(Programs.code[p]);
+        a.io(Programs.ram[p]);
+        a.io(Programs.cycles[p]);
+        a.io(Programs.pathId[p]);
+    }
+
+    checkpointState(a);
+    vector<int> offsets(Processes.size(), -1); // where each process is in its program
+    for (int h = 0; h < Processes.size(); h++) {
+        if (Processes.ip[h] != nullptr) {
+            offsets[h] = Processes.ip[h] - Programs.start(Processes.program[h]);
+        }
+    }
+    a.io(offsets);
+    return file.good();
+}
 
-// Memory management class
-class Memory {
-    public:
-        int memory[4] = {-1}; // initializes the memory (RAM) 4 pages
-        int memoryUsage = 0; // keeps track of the overall memory usage
-        
-        Memory() {
-            cout << "\nInitiating Memory";
-        }
-
-        void addProcess(Process p) {
-            if (memoryUsage < 4) { // if there is room in memory for the process we put it in there
-                for (int i = 0; i < 4; i++) {
-                    if (memory[i] == -1) {
-                        p.pState = ready; // process is now ready
-                        memory[i] = p.pid; // the momory now holds the pid for the process
-                        memoryUsage = memoryUsage + 1; // incrememnt memory usage
-                        cout << "\nAdding Process " << p.processName << " to the memory.";
-                        // cout << "\n" << 4 - memoryUsage << "MB free";
-                        break;
-                    }
-                } 
-            } else { // we will have to manage the memory/storage and remove something
-                memory[0] = memory[1];
-                memory[1] = memory[2];
-                memory[2] = memory[3];
-                memory[3] = p.pid; // the last location in the memory now holds the pid for the process
-                p.pState = ready; // the process is now ready
-                cout << "\nMemory full. Adding Process " << p.processName << " to the memory.";
-                // cout << "\n" << 4 - memoryUsage << "MB free";   
+// replaces the simulation with the checkpoint in data. A bad checkpoint leaves the simulation empty.
+bool Simulation::restoreCheckpoint(const string &path, const char *data, size_t size, string &error) {
+    CheckpointHeader header;
+    if (size < sizeof(header) || memcmp(data, checkpointMagic, sizeof(checkpointMagic)) != 0) {
+        error = path + ": not a checkpoint";
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.version != checkpointVersion) {
+        error = path + ": checkpoint version " + to_string(header.version) + " is not supported";
+        return false;
+    }
+    CheckpointReader a(data + sizeof(header), size - sizeof(header));
+    vector<char> names;
+    vector<uint32_t> lengths;
+    a.io(names);
+    a.io(lengths);
+    vector<int> nameIds; // checkpoint name id to id in Names
+    size_t at = 0;
+    for (uint32_t length : lengths) {
+        if (!a.ok || length > names.size() - at) {
+            a.fail();
+            break;
+        }
+        nameIds.push_back(Names.intern(string_view(names.data() + at, length)));
+        at += length;
+    }
+    int programCount = 0;
+    a.io(programCount);
+    vector<int> programIds; // checkpoint program id to id in Programs
+    for (int p = 0; a.ok && p < programCount; p++) {
+        vector<int> code;
+        int ram = 0, cycles = 0, pathId = -1;
+        a.io(code);
+        a.io(ram);
+        a.io(cycles);
+        a.io(pathId);
+        if (!a.ok || pathId < 0 || pathId >= (int) nameIds.size() || code.empty() || code.back() != opEnd) {
+            a.fail();
+            break;
+        }
+        for (int &instruction : code) { // OUT messages are names too
+            if ((instruction & opMask) == opOut) {
+                int message = instruction >> opBits;
+                if (message < 0 || message >= (int) nameIds.size()) {
+                    a.fail();
+                    break;
+                }
+                instruction = opOut | nameIds[message] << opBits;
             }
         }
+        if (!a.ok) {
+            break;
+        }
+        string programPath = Names.name(nameIds[pathId]);
+        auto found = Programs.byPath.find(programPath); // a program compiled earlier is reused
+        programIds.push_back(found != Programs.byPath.end() ? found->second : Programs.add(programPath, move(code), ram, cycles));
+    }
 
-        bool checkMemory(Process p) {
-            bool inMemory = false;
-            for (int i = 0; i <= 4; i++) {
-                if (memory[i] == p.pid) {
-                    inMemory = true; // if the process was found in the memory
+    if (a.ok) {
+        checkpointState(a);
+    }
+    vector<int> offsets;
+    a.io(offsets);
+    if (a.ok && offsets.size() == (size_t) Processes.size()) {
+        for (int h = 0; h < Processes.size() && a.ok; h++) {
+            int &name = Processes.nameId[h];
+            int &program = Processes.program[h];
+            if (name < 0 || name >= (int) nameIds.size() || program < -1 || program >= (int) programIds.size()) {
+                a.fail();
+                break;
+            }
+            name = nameIds[name];
+            if (program >= 0) {
+                program = programIds[program];
+                if (offsets[h] < -1 || offsets[h] >= (int) Programs.code[program].size()) {
+                    a.fail();
                     break;
                 }
+                Processes.ip[h] = offsets[h] >= 0 ? Programs.start(program) + offsets[h] : nullptr;
             }
-            if (inMemory == true) {
-                cout << "\nProcess " << p.processName << " is already in memory.";
-            } else {
-                cout << "\nProcess " << p.processName << " is not in memory.";
+        }
+    } else {
+        a.fail();
+    }
+    if (!a.ok) {
+        error = path + ": checkpoint is truncated or corrupt";
+        Processes.truncate(0);
+        readyQueue = queue<int>();
+        lastRun.clear();
+        liveProcesses = 0;
+        paused = PausedRun();
+        MainMemory.resize(4, replaceFIFO);
+        Disk.clear();
+        Locks.reset();
+        Arrivals.clear();
+        Sleepers.clear();
+        return false;
+    }
+    return true;
+}
+
+// maps a checkpoint file and restores it, returns false if it could not be restored
+bool Simulation::loadCheckpoint(const string &path) {
+    MappedFile file;
+    if (!file.map(path)) {
+        return false;
+    }
+    string error;
+    if (!restoreCheckpoint(path, file.data, file.size, error)) {
+        cerr << "\n" << error << "\n";
+        return false;
+    }
+    return true;
+}
+
+// What a schedule trace says about its run
+struct ScheduleReplay {
+    RunSummary summary; // the scheduling figures of the run, memory and locks only count evictions
+    long long records = 0;
+    long long ioRequests = 0, lockWaits = 0, criticalCycles = 0, pagesIn = 0, pagesOut = 0;
+};
+
+// Replays a schedule trace into replay, writing one Gantt chart row per dispatch to ganttPath when it
+// is set. Returns false if the trace can't be read.
+bool replaySchedule(const string &path, const string &ganttPath, ScheduleReplay &replay) {
+    MappedFile file;
+    if (!file.map(path)) {
+        return false;
+    }
+    ScheduleHeader header;
+    if (file.size < sizeof(header) || memcmp(file.data, scheduleMagic, sizeof(scheduleMagic)) != 0) {
+        cerr << "\n" << path << ": not a schedule trace\n";
+        return false;
+    }
+    memcpy(&header, file.data, sizeof(header));
+    if (header.version != scheduleVersion || header.cpus == 0) {
+        cerr << "\n" << path << ": schedule trace version " << header.version << " is not supported\n";
+        return false;
+    }
+    const char *end = file.data + file.size;
+    auto corrupt = [&path] {
+        cerr << "\n" << path << ": schedule trace is truncated or corrupt\n";
+        return false;
+    };
+
+    // the names block comes last, so the blocks are walked once to find it
+    vector<string> names;
+    vector<pair<uint32_t, const ScheduleRecord *>> blocks; // cpu and records of each block
+    vector<uint32_t> counts;
+    for (const char *at = file.data + sizeof(header); at < end;) {
+        ScheduleBlock block;
+        if ((size_t) (end - at) < sizeof(block)) {
+            return corrupt();
+        }
+        memcpy(&block, at, sizeof(block));
+        at += sizeof(block);
+        if (block.cpu == ScheduleBlock::names) {
+            if ((size_t) (end - at) / sizeof(uint32_t) < block.count) {
+                return corrupt();
             }
-            return inMemory;
+            vector<uint32_t> lengths(block.count);
+            memcpy(lengths.data(), at, block.count * sizeof(uint32_t));
+            at += block.count * sizeof(uint32_t);
+            for (uint32_t length : lengths) {
+                if ((size_t) (end - at) < length) {
+                    return corrupt();
+                }
+                names.push_back(string(at, length));
+                at += length;
+            }
+            continue;
+        }
+        if (block.cpu >= header.cpus || (size_t) (end - at) / sizeof(ScheduleRecord) < block.count) {
+            return corrupt();
         }
+        blocks.push_back(make_pair(block.cpu, (const ScheduleRecord *) at)); // the records are 8 byte aligned in the mapping
+        counts.push_back(block.count);
+        at += block.count * sizeof(ScheduleRecord);
+    }
 
-        void removeProcess(Process p) {
-            for (int i =0; i < 4; i++) {
-                if (memory[i] == p.pid) {
-                    memory[i] = -1; // if the process is found in memory we remove it
-                    memoryUsage--; // decrememnt memory usage
-                    cout << "\nRemoving Process " << p.processName << " from the memory.";
-                    // cout << "\n" << 4 - memoryUsage << "MB free";
-                    break;
+    ofstream gantt;
+    if (!ganttPath.empty()) {
+        gantt.open(ganttPath);
+        if (!gantt.is_open()) {
+            cerr << "\nCould not write " << ganttPath << "\n";
+            return false;
+        }
+        gantt << "cpu,pid,name,start,end,cycles,ending\n";
+    }
+    const char *endings[] = { "", "", "preempt", "io", "lock_wait", "terminate", "", "", "", "", "sleep" };
+    const int maxPid = 1 << 28; // anything above is taken for a corrupt record
+    vector<int> nameOf; // by pid
+    if (gantt.is_open()) { // an arrival is recorded by the CPU that ran the process first, which may come after the others
+        for (size_t b = 0; b < blocks.size(); b++) {
+            for (uint32_t i = 0; i < counts[b]; i++) {
+                ScheduleRecord r = blocks[b].second[i];
+                if ((r.stamp & 0xff) == scheduleArrival && r.pid >= 0 && r.pid < maxPid) {
+                    if (r.pid >= (int) nameOf.size()) {
+                        nameOf.resize(max((size_t) r.pid + 1, nameOf.size() * 2), -1);
+                    }
+                    nameOf[r.pid] = r.value;
                 }
             }
         }
-};
+    }
+    vector<long long> arrival, firstRun, completion, waiting; // by pid
+    int cpus = header.cpus;
+    vector<int> running(cpus, -1), lastPid(cpus, -1); // pid each CPU is running and ran last
+    vector<long long> started(cpus, 0);
+    RunSummary &s = replay.summary;
+    long long busy = 0;
+    for (size_t b = 0; b < blocks.size(); b++) {
+        int cpu = blocks[b].first;
+        for (uint32_t i = 0; i < counts[b]; i++) {
+            ScheduleRecord r = blocks[b].second[i];
+            long long cycle = r.stamp >> 8;
+            int event = r.stamp & 0xff;
+            int pid = r.pid;
+            if (pid < 0 || pid >= maxPid || event > scheduleSleep) {
+                return corrupt();
+            }
+            if (pid >= (int) arrival.size()) {
+                size_t size = max((size_t) pid + 1, arrival.size() * 2);
+                arrival.resize(size, 0);
+                firstRun.resize(size, -1);
+                completion.resize(size, -1);
+                waiting.resize(size, 0);
+            }
+            switch (event) {
+                case scheduleArrival:
+                    arrival[pid] = cycle;
+                    break;
+                case scheduleDispatch:
+                    if (running[cpu] >= 0) {
+                        return corrupt();
+                    }
+                    running[cpu] = pid;
+                    started[cpu] = cycle;
+                    s.dispatches++;
+                    if (lastPid[cpu] != pid) {
+                        s.contextSwitches++;
+                        lastPid[cpu] = pid;
+                    }
+                    waiting[pid] += r.value;
+                    if (firstRun[pid] < 0 || cycle < firstRun[pid]) { // the blocks of different CPUs aren't in clock order
+                        firstRun[pid] = cycle;
+                    }
+                    break;
+                case scheduleCriticalEnter:
+                    replay.criticalCycles -= cycle;
+                    break;
+                case scheduleCriticalExit:
+                    replay.criticalCycles += cycle;
+                    break;
+                case schedulePagesIn:
+                    replay.pagesIn += r.value;
+                    break;
+                case schedulePagesOut:
+                    replay.pagesOut += r.value;
+                    break;
+                default: // the dispatch ended
+                    if (running[cpu] != pid) {
+                        return corrupt();
+                    }
+                    running[cpu] = -1;
+                    busy += r.value;
+                    replay.ioRequests += event == scheduleIO;
+                    replay.lockWaits += event == scheduleLockWait;
+                    if (event == scheduleTerminate) {
+                        completion[pid] = cycle;
+                        s.makespan = max(s.makespan, cycle);
+                    }
+                    if (gantt.is_open()) {
+                        int name = pid < (int) nameOf.size() ? nameOf[pid] : -1;
+                        gantt << cpu << "," << pid << "," << (name >= 0 && name < (int) names.size() ? names[name] : "") << ","
+                              << started[cpu] << "," << cycle << "," << r.value << "," << endings[event] << "\n";
+                    }
+            }
+            replay.records++;
+        }
+    }
 
+    vector<long long> turnaround, waitingTimes, response;
+    for (size_t pid = 0; pid < completion.size(); pid++) {
+        if (completion[pid] >= 0) {
+            turnaround.push_back(completion[pid] - arrival[pid]);
+            waitingTimes.push_back(waiting[pid]);
+            response.push_back(firstRun[pid] - arrival[pid]);
+        }
+    }
+    s.cpus = cpus;
+    s.processes = turnaround.size();
+    s.throughput = s.makespan > 0 ? 1000.0 * s.processes / s.makespan : 0;
+    s.utilization = s.makespan > 0 ? (double) busy / ((double) cpus * s.makespan) : 0;
+    s.fairness = fairness(turnaround, waitingTimes);
+    s.meanTurnaround = mean(turnaround);
+    s.p99Turnaround = percentile(turnaround, 0.99);
+    s.meanWaiting = mean(waitingTimes);
+    s.p99Waiting = percentile(waitingTimes, 0.99);
+    s.meanResponse = mean(response);
+    s.p99Response = percentile(response, 0.99);
+    s.memoryEvictions = replay.pagesOut;
+    return !gantt.is_open() || gantt.good();
+}
 
-// global variables
-    int numberOfProcesses = 0; // keeps track of the number of process created thus far so the pids don't overlap
-    queue<Process> readyQueue; // empty readyQueue for processes
-    Memory MainMemory = Memory();
-    mutex mtx;
+// format is "text", "json" or "csv" like the run summaries
+void printReplay(ScheduleReplay &replay, const string &format) {
+    RunSummary &s = replay.summary;
+    if (format == "json") {
+        cout << "{";
+        printSummaryFields(cout, s, format, false);
+        cout << ",\"records\":" << replay.records << ",\"io_requests\":" << replay.ioRequests << ",\"lock_waits\":" << replay.lockWaits
+             << ",\"critical_cycles\":" << replay.criticalCycles << ",\"pages_in\":" << replay.pagesIn << ",\"pages_out\":" << replay.pagesOut << "}\n";
+    } else if (format == "csv") {
+        cout << summaryColumns << ",records,io_requests,lock_waits,critical_cycles,pages_in,pages_out\n";
+        printSummaryFields(cout, s, format, false);
+        cout << "," << replay.records << "," << replay.ioRequests << "," << replay.lockWaits << "," << replay.criticalCycles
+             << "," << replay.pagesIn << "," << replay.pagesOut << "\n";
+    } else {
+        cout << "\nReplayed " << replay.records << " records: " << s.cpus << " CPUs ran " << s.processes << " processes in " << s.dispatches << " dispatches";
+        cout << "\nFinished in " << s.makespan << " cycles with " << s.contextSwitches << " context switches";
+        cout << "\nTurnaround mean " << s.meanTurnaround << " p99 " << s.p99Turnaround;
+        cout << ", waiting mean " << s.meanWaiting << " p99 " << s.p99Waiting;
+        cout << ", response mean " << s.meanResponse << " p99 " << s.p99Response;
+        cout << "\nFairness " << s.fairness << ", CPU utilization " << 100 * s.utilization << "%";
+        cout << "\n" << replay.ioRequests << " io requests, " << replay.lockWaits << " lock waits, " << replay.criticalCycles
+             << " cycles in critical sections, " << replay.pagesIn << " pages read in, " << replay.pagesOut << " evicted";
+    }
+}
 
-void helpMenu() {
-    cout << "\nList of commands: help";
-    cout << "\nAdd a job: add <path to jobFile>";
-    cout << "\nCreate a process: create process";
-    cout << "\nGenerate processes: generate";
-    cout << "\nRun the round robin: run round";
-    cout << "\nRun the priority: run priority";
+void batchUsage() {
+    cerr << "usage: OpSim --convert <text jobFile> <binary jobFile>\n"
+         << "       OpSim [--job <jobFile>]... [--generate <count>] [--scheduler round|priority|mlfq|fair|srtf]\n"
+         << "             [--program <programFile>[:<count>]]... [--quantum <cycles>] [--boost <cycles>] [--cpus <count>]\n"
+         << "             [--frames <count>] [--frame-size <MB>] [--replacement fifo|lru|clock|ws] [--fault-cycles <cycles>]\n"
+         << "             [--working-set <cycles>]\n"
+         << "             [--log quiet|info|debug] [--format json|csv|text]\n"
+         << "             [--stream <jobFile> | --stream-generate <count> [--arrival-gap <cycles>]] [--active <count>]\n"
+         << "             [--seed <number>] [--deterministic] [--metrics <file.csv|file.json>] [--semaphore <lock>:<count>]...\n"
+         << "             [--restore <file>] [--stop-at <cycle>] [--checkpoint <file>] [--record <schedule trace>]\n"
+         << "             [--topology <cpus per cache>:<caches per node>] [--migration <cache>:<node>:<remote>]\n"
+         << "             [--warmth <cycles>] [--balance free|aware]\n"
+         << "             [--cycles|--priorities|--critical-start|--critical-length|--io-point <distribution>]...\n"
+         << "       OpSim --replay <schedule trace> [--gantt <file.csv>] [--format json|csv|text]\n"
+         << "       OpSim --sweep [--schedulers <list>] [--quanta <list>] [--frames <list>] [--loads <list>] [--cpus <list>]\n"
+         << "             [--seeds <list>] [--boost <cycles>] [--replacement fifo|lru|clock|ws] [--frame-size <MB>]\n"
+         << "             [--fault-cycles <cycles>] [--working-set <cycles>] [--restore <file>] [--threads <count>] [--format csv|json]\n"
+         << "             [--topology <cpus per cache>:<caches per node>] [--migration <cache>:<node>:<remote>]\n"
+         << "             [--warmth <cycles>] [--balancers free,aware]\n"
+         << "             [--cycles|--priorities|--critical-start|--critical-length|--io-point <distribution>]...\n"
+         << "       OpSim --bench [--sizes <list>] [--threads <list>] [--repeat <count>] [--filter <name>] [--format text|csv|json]\n"
+         << "Runs the jobs without the command prompt and prints a summary of the run.\n"
+         << "Job files can be text or converted binary files. Streamed processes are read or generated\n"
+         << "while the schedulers run, with at most --active of them in the process table at once.\n"
+         << "--semaphore lets count processes hold a lock at once, every lock is a mutex by default.\n"
+         << "Memory is paged in pages of --frame-size MB, --fault-cycles is what a page fault costs the CPU\n"
+         << "and ws replacement keeps the pages each process used in its last --working-set cycles.\n"
+         << "--metrics writes per process counters and turnaround and response histograms of the run.\n"
+         << "--stop-at stops the run once every CPU reaches the cycle, --checkpoint saves the simulation and a stopped\n"
+         << "run after it and --restore loads one back before the other flags, so the run carries on from there.\n"
+         << "--record writes a binary schedule trace of the run, --replay reads one back into the run's scheduling\n"
+         << "figures and --gantt writes a row per dispatch for a Gantt chart.\n"
+         << "--topology groups the CPUs into caches and the caches into nodes, and a process dispatched away from\n"
+         << "the CPU it last ran on within --warmth cycles stalls the new CPU for the --migration cost of that move.\n"
+         << "The aware balancer steals from the nearest CPUs first and only when the queue is worth the move.\n"
+         << "--seed picks the generated workload and --deterministic runs the CPUs in simulated time order\n"
+         << "on one thread so the same run always gives the same results.\n"
+         << "Generated processes draw each field from a distribution: uniform:<low>:<high>, exponential:<mean>[:<cap>]\n"
+         << "or pareto:<low>:<shape>[:<cap>], a high or cap of 0 means the end of the process for --critical-start and --io-point.\n"
+         << "--sweep runs every combination of the comma separated lists as its own simulation of --loads\n"
+         << "generated processes, spread over --threads host threads (all cores by default).\n"
+         << "--bench times dispatches, memory hits, evictions and accesses, job file loading and process generation\n"
+         << "and prints the median and standard deviation of each over --repeat runs (default 5).\n";
 }
 
-void generateProcesses(int number) {
-    int pid;
-    int totalCycles;
-    string name;
-    int priority;
-    int criticalStart;
-    int criticalLength;
-    int inputOutput;
-    for (int i = 0; i < number; i++) {
-        pid = numberOfProcesses;
-        name = "generated";
-        numberOfProcesses++;
-        totalCycles = rand() % 200 + 51; // random number from 50 to 250
-        priority = rand() % 3; // random number from 0 to 2
-        criticalStart = rand() % (totalCycles - 31) + 31; // random number from 30 to to 210
-        criticalLength = rand() % 40 + 21; // random number from 20 to 60 
-        inputOutput = rand() & (totalCycles - 31) + 31; 
-        Process p = Process(pid, totalCycles, name, priority, criticalStart, criticalLength, inputOutput);
-        readyQueue.push(p);
+// Headless mode: the command line picks the workload and the scheduler settings, the run is made
+// once and its summary is the only thing written to stdout.
+int runBatch(int argc, char* argv[]) {
+    verbose = false;
+    if (string(argv[1]) == "--convert") {
+        if (argc != 4) {
+            cerr << "usage: OpSim --convert <text jobFile> <binary jobFile>\n";
+            return 1;
+        }
+        return Simulator.convertJobFile(argv[2], argv[3]) ? 0 : 1;
+    }
+    Trace.level = logQuiet;
+    string scheduler = "round";
+    string format = "json";
+    for (int i = 1; i + 1 < argc; i++) { // restored first so the other flags change what it holds
+        if (string(argv[i]) == "--restore" && !Simulator.loadCheckpoint(argv[i + 1])) {
+            return 1;
+        }
+    }
+    int frameCount = Simulator.MainMemory.frameOwner.size();
+    int replacement = Simulator.MainMemory.policy;
+    bool resizeMemory = false; // memory is only cleared when one of its flags is given
+    int faultCycles = Simulator.MainMemory.faultCycles; // cycles a page fault stalls the CPU
+    int workingSet = Simulator.MainMemory.workingSetWindow; // cycles the working set looks back over
+    string checkpointPath;
+    vector<string> jobFiles;
+    vector<pair<string, int>> programFiles;
+    int frameSize = 0; // keeps the memory's frame size
+    int generate = 0;
+    string streamFile;
+    int streamCount = 0;
+    double arrivalGap = 10; // mean cycles between generated arrivals
+    int activeLimit = 4096;
+    for (int i = 1; i < argc; i++) {
+        string flag = argv[i];
+        if (flag == "--help" || flag == "-h") {
+            batchUsage();
+            return 0;
+        }
+        if (flag == "--deterministic") {
+            Simulator.interleaved = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            cerr << "missing value for " << flag << "\n";
+            batchUsage();
+            return 1;
+        }
+        string value = argv[++i];
+        if (flag == "--job") {
+            jobFiles.push_back(value);
+        } else if (flag == "--generate") {
+            generate = atoi(value.c_str());
+        } else if (flag == "--program") {
+            size_t colon = value.find_last_of(':');
+            int count = colon == string::npos ? 1 : max(0, atoi(value.c_str() + colon + 1));
+            programFiles.push_back(make_pair(value.substr(0, colon), count));
+        } else if (flag == "--frame-size") {
+            frameSize = max(1, atoi(value.c_str()));
+            resizeMemory = true;
+        } else if (flag == "--scheduler" && schedulerNamed(value) != nullptr) {
+            scheduler = value;
+        } else if (flag == "--boost") {
+            Simulator.boostPeriod = max(1, atoi(value.c_str()));
+        } else if (flag == "--quantum") {
+            Simulator.quantum = max(1, atoi(value.c_str()));
+        } else if (flag == "--cpus") {
+            Simulator.numberOfCPUs = max(1, atoi(value.c_str()));
+        } else if (flag == "--frames") {
+            frameCount = max(1, atoi(value.c_str()));
+            resizeMemory = true;
+        } else if (flag == "--replacement" && replacementNamed(value) >= 0) {
+            replacement = replacementNamed(value);
+            resizeMemory = true;
+        } else if (flag == "--fault-cycles") {
+            faultCycles = max(0, atoi(value.c_str()));
+        } else if (flag == "--working-set") {
+            workingSet = max(1, atoi(value.c_str()));
+        } else if (flag == "--log" && (value == "quiet" || value == "info" || value == "debug")) {
+            Trace.level = value == "quiet" ? logQuiet : value == "info" ? logInfo : logDebug;
+            Trace.out = &cerr; // keeps stdout for the summary
+        } else if (flag == "--format" && (value == "json" || value == "csv" || value == "text")) {
+            format = value;
+        } else if (flag == "--stream") {
+            streamFile = value;
+        } else if (flag == "--stream-generate") {
+            streamCount = max(0, atoi(value.c_str()));
+        } else if (flag == "--arrival-gap") {
+            arrivalGap = max(0.0, atof(value.c_str()));
+        } else if (flag == "--active") {
+            activeLimit = max(1, atoi(value.c_str()));
+        } else if (flag == "--semaphore") {
+            size_t colon = value.find(':');
+            int id = atoi(value.c_str());
+            if (colon == string::npos || id < 0 || id >= LockTable::maxLocks) {
+                cerr << "bad option " << flag << " " << value << "\n";
+                batchUsage();
+                return 1;
+            }
+            Simulator.Locks.locks[id].capacity = max(1, atoi(value.c_str() + colon + 1));
+        } else if (flag == "--metrics") {
+            Simulator.metricsPath = value;
+        } else if (flag == "--seed") {
+            Simulator.random = FastRandom(strtoull(value.c_str(), nullptr, 10));
+        } else if (flag == "--stop-at") {
+            Simulator.stopAt = max(0LL, atoll(value.c_str()));
+        } else if (flag == "--checkpoint") {
+            checkpointPath = value;
+        } else if (flag == "--record") {
+            Simulator.schedulePath = value;
+        } else if (flag == "--topology" || flag == "--migration") {
+            if (!(flag == "--topology" ? parseTopology(value, Simulator.topology) : parseMigration(value, Simulator.topology))) {
+                cerr << "bad option " << flag << " " << value << "\n";
+                batchUsage();
+                return 1;
+            }
+        } else if (flag == "--warmth") {
+            Simulator.topology.warmth = max(0, atoi(value.c_str()));
+        } else if (flag == "--balance" && (value == "free" || value == "aware")) {
+            Simulator.topology.aware = value == "aware";
+        } else if (flag.compare(0, 2, "--") == 0 && Simulator.workload.field(flag.substr(2)) != nullptr) {
+            if (!parseDistribution(value, *Simulator.workload.field(flag.substr(2)))) {
+                cerr << "bad distribution " << flag << " " << value << "\n";
+                batchUsage();
+                return 1;
+            }
+        } else if (flag != "--restore") {
+            cerr << "bad option " << flag << " " << value << "\n";
+            batchUsage();
+            return 1;
+        }
     }
+    if (resizeMemory) {
+        Simulator.MainMemory.resize(frameCount, replacement, frameSize);
+    }
+    Simulator.MainMemory.faultCycles = faultCycles;
+    Simulator.MainMemory.workingSetWindow = workingSet;
+    for (string &path : jobFiles) {
+        Simulator.addFile(path);
+    }
+    for (auto &program : programFiles) {
+        Simulator.addProgram(program.first, program.second);
+    }
+    Simulator.generateProcesses(generate);
+    function<void()> producer;
+    if (!streamFile.empty()) {
+        producer = [streamFile] { Simulator.streamJobFile(streamFile); };
+    } else if (streamCount > 0) {
+        producer = [streamCount, arrivalGap] { Simulator.streamGenerated(streamCount, arrivalGap); };
+    }
+    if (Simulator.readyQueue.empty() && !producer && !Simulator.paused.active) {
+        cerr << "no processes to run, give --job, --program, --generate, --stream, --stream-generate or --restore\n";
+        return 1;
+    }
+    int runCPUs = Simulator.paused.active && !producer ? Simulator.paused.clocks.size() : Simulator.numberOfCPUs;
+    if (!Simulator.topology.fits(runCPUs)) {
+        cerr << "--topology " << Simulator.topology.coresPerCache << ":" << Simulator.topology.cachesPerNode
+             << " doesn't split " << runCPUs << " CPUs into whole caches and nodes\n";
+        return 1;
+    }
+    RunSummary summary = (Simulator.*schedulerNamed(scheduler))(Simulator.numberOfCPUs, producer, activeLimit);
+    Simulator.printSummary(summary, format);
+    if (Simulator.paused.active) {
+        cerr << "stopped at cycle " << Simulator.stopAt << " with " << Simulator.liveProcesses << " processes left\n";
+    }
+    if (!checkpointPath.empty() && !Simulator.saveCheckpoint(checkpointPath)) {
+        return 1;
+    }
+    return 0;
 }
 
-void roundRobin() {
-    int cycles = 20; // number of cycles before switching to the next process
-    while (!readyQueue.empty()) {
-        mtx.lock(); // locks when the thread is going to access the ready queue
-        Process current = readyQueue.front(); // sets current to the front of the queue
-        bool inMemory = MainMemory.checkMemory(current); 
-        if (inMemory == false) { // checks if the current process is in memory and adds it to the memory if it isn't
-            MainMemory.addProcess(current); // adds the process to the memory if it is not already in it
-        }
-        readyQueue.pop(); // removes current from the queue
-        current.pState = running; // the current process is now running
-        mtx.unlock(); // unlocks after the thread has accessed the queue
-        for (int i = 0; i < cycles; i++) { // for loop simulates running a cycle on the CPU
-            current.remainingCycles--;
-            current.criticalStart--; // if critical section gets to 0 the critical section has started
-            current.inputOutput--;
-            if (current.criticalStart == 0) {
-                cout << "\nCritical Section Started for process " << current.processName << " pid: " << current.pid;
-                break; // when the critical section starts we break from the normal cycle
-            }
-            if (current.inputOutput == 0){
-                cout << "\nIO INTERUPT in process: " << current.processName << " pid: " << current.pid;
-                usleep(1000);
-            }
-        }
-
-        if (current.criticalStart == 0) { // checks of critical start point has been reached and if there are still cycles left in the critical section
-            for (int i = 0; i < current.criticalLength; i++) {
-                current.remainingCycles--;
-                current.inputOutput--;
-                if (current.inputOutput == 0){
-                    cout << "\nIO INTERUPT in process: " << current.processName << " pid: " << current.pid;
-                    usleep(1000);
-                }
-            }
-        }
-
-        if (current.remainingCycles < 0) { // checks if the process has finished
-            mtx.lock();
-            MainMemory.removeProcess(current); // removes a process from the memory when it is being terminated
-            cout << "\nFinishing process " << current.processName << " pid: " << current.pid;
-            current.pState = terminated; // sets the processes state to terminated
-            mtx.unlock();
+// Replay mode: the scheduling figures of a recorded run, from its schedule trace alone
+int runReplay(int argc, char* argv[]) {
+    verbose = false;
+    if (argc < 3) {
+        batchUsage();
+        return 1;
+    }
+    string path = argv[2];
+    string ganttPath;
+    string format = "json";
+    for (int i = 3; i < argc; i++) {
+        string flag = argv[i];
+        if (i + 1 >= argc) {
+            cerr << "missing value for " << flag << "\n";
+            batchUsage();
+            return 1;
+        }
+        string value = argv[++i];
+        if (flag == "--gantt") {
+            ganttPath = value;
+        } else if (flag == "--format" && (value == "json" || value == "csv" || value == "text")) {
+            format = value;
         } else {
-            mtx.lock();
-            current.pState = ready; // the process is being put back into the ready queue
-            cout << "\nRunning " << current.processName << " pid: " << current.pid << " has " << current.remainingCycles << " cycles left before it completes.";
-            readyQueue.push(current); // puts the current process at the back of the queue to wait for its turn again
-            mtx.unlock();
+            cerr << "bad option " << flag << " " << value << "\n";
+            batchUsage();
+            return 1;
         }
     }
-    return;
+    ScheduleReplay replay;
+    if (!replaySchedule(path, ganttPath, replay)) {
+        return 1;
+    }
+    printReplay(replay, format);
+    return 0;
 }
 
-void priorityRobin() {
-    int cycles = 20; // number of cycles before switching to the next process
-    int runningCycles = 20;
-    while (!readyQueue.empty()) {
-        mtx.lock(); // locks to access the ready queue
-        Process current = readyQueue.front(); // sets current to the front of the queue
-        bool inMemory = MainMemory.checkMemory(current); 
-        if (inMemory == false) { // checks if the current process is in memory and adds it to the memory if it isn't
-            MainMemory.addProcess(current); // adds the process to the memory if it is not already in it
-        }
-        readyQueue.pop(); // removes current from the queue
-        mtx.unlock(); // unlocks once the queue has been accessed
-        current.pState = running; // the current process is now running
-        if (current.priority == 0) { // low priority
-            runningCycles = 20;
-        } else if (current.priority == 1) { // medium priority
-            runningCycles = 25;
-        } else if (current.priority == 2) { // high priority
-            runningCycles = 30;
-        }
-        for (int i = 0; i < runningCycles; i++) { // for loop simulates running a cycle on the CPU
-            current.remainingCycles--;
-            current.criticalStart--; // if critical section gets to 0 the critical section has started
-            current.inputOutput--;
-            if (current.criticalStart == 0) {
-                cout << "\nCritical Section Started for process " << current.processName << " pid: " << current.pid;
-                break; // when the critical section starts we break from the normal cycle
-            }
-            if (current.inputOutput == 0) {
-                cout << "\nIO INTERUPT in process: " << current.processName << " pid: " << current.pid;
-                usleep(1000);
-            }
-        }
-
-        if (current.criticalStart == 0) { // checks of critical start point has been reached and if there are still cycles left in the critical section
-            for (int i = 0; i < current.criticalLength; i++) {
-                current.remainingCycles--;
-                current.inputOutput--;
-                if (current.inputOutput == 0){
-                    cout << "\nIO INTERUPT in process: " << current.processName << " pid: " << current.pid;
-                    usleep(1000);
-                }
-            }
-        }
-
-        if (current.remainingCycles < 0) { // checks if the process has finished
-            mtx.lock();
-            MainMemory.removeProcess(current); // removes a process from the memory when it is being terminated
-            cout << "\nFinishing process " << current.processName << " pid: " << current.pid;
-            current.pState = terminated; // sets the processes state to terminated
-            mtx.unlock();
-        } else {
-            current.pState = ready; // the process is being put back into the ready queue
-            mtx.lock();
-            cout << "\nRunning " << current.processName << " pid: " << current.pid << " has " << current.remainingCycles << " cycles left before it completes.";
-            readyQueue.push(current); // puts the current process at the back of the queue to wait for its turn again
-            mtx.unlock();
+// One simulation of a sweep
+struct SweepConfig {
+    string scheduler;
+    int quantum;
+    int frames;
+    int load; // generated processes
+    int cpus;
+    uint64_t seed;
+    bool aware; // topology aware balancer
+};
+
+// comma separated list, empty entries are skipped
+vector<string> splitList(const string &text) {
+    vector<string> items;
+    stringstream list(text);
+    string item;
+    while (getline(list, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
         }
-        
     }
-    return;
+    return items;
 }
 
+// comma separated numbers, each at least minimum
+vector<int> numberList(const string &text, int minimum) {
+    vector<int> numbers;
+    for (string &item : splitList(text)) {
+        numbers.push_back(max(minimum, atoi(item.c_str())));
+    }
+    return numbers;
+}
 
-void addUserProcess(int numProc) {
-    int pid = numProc;
-    cout << "\nEnter the amount of cycles this process takes: ";
-    int totalCycles;
-    cin >> totalCycles;
-    cout << "\nEnter the process name: ";
+// Sweep mode: every combination of the listed settings is its own simulation with its own process
+// table, memory and generator, and a pool of host threads takes them in turn. Each one generates its
+// workload from its seed and runs its CPUs interleaved on one thread, so a row only depends on its
+// settings and the output is the same whatever the thread count. Rows come out in the order of the
+// lists and the wall clock time goes to stderr.
+int runSweep(int argc, char* argv[]) {
+    verbose = false;
+    Trace.level = logQuiet;
+    vector<string> schedulers = { "round" };
+    vector<int> quanta = { 20 }, frames = { 4 }, loads = { 1000 }, cpus = { 2 }, seeds = { 1 };
+    int boost = 1000;
+    int replacement = replaceFIFO;
+    int faultCycles = -1; // cycles a page fault stalls the CPU, -1 keeps the memory's
+    int workingSet = -1; // cycles the working set looks back over, -1 keeps the memory's
+    int frameSize = 0;
+    Topology topology; // of every simulated machine
+    vector<string> balancers = { "aware" };
+    string restorePath; // every simulation starts from this checkpoint instead of generating its load
+    bool resizeMemory = false; // a restored memory is kept unless one of its flags is given
+    Workload workload; // of every generated load
+    int threads = max(1u, thread::hardware_concurrency());
+    string format = "csv";
+    for (int i = 2; i < argc; i++) {
+        string flag = argv[i];
+        if (flag == "--help" || flag == "-h") {
+            batchUsage();
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            cerr << "missing value for " << flag << "\n";
+            batchUsage();
+            return 1;
+        }
+        string value = argv[++i];
+        if (flag == "--schedulers") {
+            schedulers = splitList(value);
+        } else if (flag == "--quanta") {
+            quanta = numberList(value, 1);
+        } else if (flag == "--frames") {
+            frames = numberList(value, 1);
+            resizeMemory = true;
+        } else if (flag == "--loads") {
+            loads = numberList(value, 0);
+        } else if (flag == "--cpus") {
+            cpus = numberList(value, 1);
+        } else if (flag == "--seeds") {
+            seeds = numberList(value, 0);
+        } else if (flag == "--boost") {
+            boost = max(1, atoi(value.c_str()));
+        } else if (flag == "--replacement" && replacementNamed(value) >= 0) {
+            replacement = replacementNamed(value);
+            resizeMemory = true;
+        } else if (flag == "--fault-cycles") {
+            faultCycles = max(0, atoi(value.c_str()));
+        } else if (flag == "--working-set") {
+            workingSet = max(1, atoi(value.c_str()));
+        } else if (flag == "--frame-size") {
+            frameSize = max(1, atoi(value.c_str()));
+            resizeMemory = true;
+        } else if (flag == "--restore") {
+            restorePath = value;
+        } else if (flag == "--topology" || flag == "--migration") {
+            if (!(flag == "--topology" ? parseTopology(value, topology) : parseMigration(value, topology))) {
+                cerr << "bad option " << flag << " " << value << "\n";
+                batchUsage();
+                return 1;
+            }
+        } else if (flag == "--warmth") {
+            topology.warmth = max(0, atoi(value.c_str()));
+        } else if (flag == "--balancers") {
+            balancers = splitList(value);
+        } else if (flag.compare(0, 2, "--") == 0 && workload.field(flag.substr(2)) != nullptr) {
+            if (!parseDistribution(value, *workload.field(flag.substr(2)))) {
+                cerr << "bad distribution " << flag << " " << value << "\n";
+                batchUsage();
+                return 1;
+            }
+        } else if (flag == "--threads") {
+            threads = max(1, atoi(value.c_str()));
+        } else if (flag == "--format" && (value == "json" || value == "csv")) {
+            format = value;
+        } else {
+            cerr << "bad option " << flag << " " << value << "\n";
+            batchUsage();
+            return 1;
+        }
+    }
+    for (string &name : schedulers) {
+        if (schedulerNamed(name) == nullptr) {
+            cerr << "no scheduler named " << name << "\n";
+            return 1;
+        }
+    }
+    for (string &name : balancers) {
+        if (name != "free" && name != "aware") {
+            cerr << "no balancer named " << name << "\n";
+            return 1;
+        }
+    }
+    MappedFile checkpoint;
+    if (!restorePath.empty()) {
+        // restored once here so a bad file stops the sweep and its names and programs are
+        // registered before the workers restore it
+        unique_ptr<Simulation> first(new Simulation());
+        string error;
+        if (!checkpoint.map(restorePath)) {
+            return 1;
+        }
+        if (!first->restoreCheckpoint(restorePath, checkpoint.data, checkpoint.size, error)) {
+            cerr << error << "\n";
+            return 1;
+        }
+        if (first->paused.active) { // it would carry on with its own CPUs and generator whatever the row says
+            cerr << restorePath << ": a stopped run can't be swept, save the checkpoint between runs\n";
+            return 1;
+        }
+        loads = { first->Processes.size() };
+        if (!resizeMemory) {
+            frames = { (int) first->MainMemory.frameOwner.size() };
+        }
+    } else {
+        resizeMemory = true;
+    }
+
+    vector<SweepConfig> configs;
+    for (string &scheduler : schedulers) {
+        for (int quantum : quanta) {
+            for (int frameCount : frames) {
+                for (int load : loads) {
+                    for (int cpuCount : cpus) {
+                        for (int seed : seeds) {
+                            for (string &balancer : balancers) {
+                                configs.push_back(SweepConfig{scheduler, quantum, frameCount, load, cpuCount, (uint64_t) seed,
+                                                              balancer == "aware"});
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    vector<RunSummary> results(configs.size());
+    atomic<size_t> nextConfig{0};
+    auto worker = [&] {
+        for (size_t i = nextConfig++; i < configs.size(); i = nextConfig++) {
+            SweepConfig &c = configs[i];
+            unique_ptr<Simulation> sim(new Simulation(c.seed));
+            string error;
+            if (!restorePath.empty()) {
+                sim->restoreCheckpoint(restorePath, checkpoint.data, checkpoint.size, error);
+                sim->stopAt = 0; // every row is a whole run
+                sim->random = FastRandom(c.seed); // the row's seed rather than the saved generator
+            }
+            sim->interleaved = true;
+            sim->quantum = c.quantum;
+            sim->boostPeriod = boost;
+            sim->topology = topology;
+            sim->topology.aware = c.aware;
+            if (resizeMemory) {
+                sim->MainMemory.resize(c.frames, replacement, frameSize);
+            }
+            if (faultCycles >= 0) {
+                sim->MainMemory.faultCycles = faultCycles;
+            }
+            if (workingSet >= 0) {
+                sim->MainMemory.workingSetWindow = workingSet;
+            }
+            if (restorePath.empty()) {
+                sim->workload = workload;
+                sim->generateThreads = 1; // the sweep already has a simulation on every thread
+                sim->generateProcesses(c.load);
+            }
+            results[i] = (sim.get()->*schedulerNamed(c.scheduler))(c.cpus, nullptr, 0);
+        }
+    };
+    auto start = chrono::steady_clock::now();
+    vector<thread> pool;
+    for (int i = 0; i < min(threads, (int) configs.size()); i++) {
+        pool.push_back(thread(worker));
+    }
+    for (thread &t : pool) {
+        t.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    if (format == "csv") {
+        cout << "scheduler,quantum,frames,load,seed,balancer," << summaryColumns << "\n";
+    }
+    for (size_t i = 0; i < configs.size(); i++) {
+        SweepConfig &c = configs[i];
+        if (format == "json") {
+            cout << "{\"scheduler\":\"" << c.scheduler << "\",\"quantum\":" << c.quantum << ",\"frames\":" << c.frames
+                 << ",\"load\":" << c.load << ",\"seed\":" << c.seed << ",\"balancer\":\"" << (c.aware ? "aware" : "free") << "\",";
+            printSummaryFields(cout, results[i], format, false);
+            cout << "}\n";
+        } else {
+            cout << c.scheduler << "," << c.quantum << "," << c.frames << "," << c.load << "," << c.seed << ","
+                 << (c.aware ? "aware" : "free") << ",";
+            printSummaryFields(cout, results[i], format, false);
+            cout << "\n";
+        }
+    }
+    cerr << "Ran " << configs.size() << " simulations on " << pool.size() << " threads in " << seconds << "s\n";
+    return 0;
+}
+
+// One benchmark of the --bench suite. run does its own setup, times only the part being measured
+// and returns those seconds along with the number of operations it did.
+struct Benchmark {
     string name;
-    cin >> name;
-    cout << "\nEnter the process' priority: ";
-    int priority;
-    cin >> priority;
-    cout << "\nEnter the start cycle for the critical section: ";
-    int criticalStart;
-    cin >> criticalStart;
-    cout << "\nEnter the length of the critical section in cycles: ";
-    int criticalLength;
-    cin >> criticalLength;
-    cout << "\nEnter the location of the inputOutput: ";
-    int inputOutput;
-    cin >> inputOutput;
-    cout << "\nCreating a process: " << name << ".";
-    Process p = Process(pid, totalCycles, name, priority, criticalStart, criticalLength, inputOutput);
-    readyQueue.push(p);
-    return;
+    int size;
+    int threads;
+    function<double(long long &ops)> run;
+};
+
+// writes count generated processes as a text or binary job file for the loader benchmarks, sim only lends its table
+void writeBenchJobFile(Simulation &sim, const string &path, int count, bool binary) {
+    sim.generateProcesses(count);
+    if (binary) {
+        sim.writeBinaryJobs(path, 0, count);
+    } else {
+        ofstream file(path, ios::trunc);
+        for (int h = 0; h < count; h++) {
+            file << "NAME " << Names.name(sim.Processes.nameId[h]) << "\nLOAD " << sim.Processes.totalCycles[h]
+                 << "\nPRIORITY " << (int) sim.Processes.priority[h] << "\nCRITICALS " << sim.Processes.criticalStart[h]
+                 << "\nCRITICALL " << sim.Processes.criticalLength[h] << "\nIO " << sim.Processes.inputOutput[h] << "\n-\n";
+        }
+        file << "EXE\n";
+    }
+    sim.Processes.truncate(0);
+    sim.readyQueue = queue<int>();
+    sim.numberOfProcesses = 0;
 }
 
+// Microbenchmarks of the hot paths: a dispatch under each scheduler, memory hits and evictions under
+// each replacement policy, loading text and binary job files and generating processes. Every
+// benchmark runs once to warm up and then repeat times, and reports the median and standard
+// deviation of the time per operation over the repetitions along with operations per second.
+int runBench(int argc, char* argv[]) {
+    verbose = false;
+    Trace.level = logQuiet;
+    vector<int> sizes = { 1000, 100000 };
+    vector<int> threadCounts = { 1, max(1, (int) thread::hardware_concurrency()) };
+    int repeat = 5;
+    string filter;
+    string format = "text";
+    for (int i = 2; i < argc; i++) {
+        string flag = argv[i];
+        if (flag == "--help" || flag == "-h") {
+            batchUsage();
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            cerr << "missing value for " << flag << "\n";
+            batchUsage();
+            return 1;
+        }
+        string value = argv[++i];
+        if (flag == "--sizes") {
+            sizes = numberList(value, 1);
+        } else if (flag == "--threads") {
+            threadCounts = numberList(value, 1);
+        } else if (flag == "--repeat") {
+            repeat = max(1, atoi(value.c_str()));
+        } else if (flag == "--filter") {
+            filter = value;
+        } else if (flag == "--format" && (value == "json" || value == "csv" || value == "text")) {
+            format = value;
+        } else {
+            cerr << "bad option " << flag << " " << value << "\n";
+            batchUsage();
+            return 1;
+        }
+    }
+    sort(threadCounts.begin(), threadCounts.end());
+    threadCounts.erase(unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
 
-void addFile(string path) {
-    ifstream jobFile; // creates input file stream
-    jobFile.open(path); // points jobFile to the path given
-    if (jobFile.is_open()) {
-        cout << "\n" << path << " opened";
-        string line;
-        string name = "default";
-        string cycleString;
-        int cycles = -1;
-        string priorityString;
-        int priority = -1;
-        string criticalStartString;
-        int criticalStart = -1;
-        string criticalLengthString;
-        int criticalLength = 0;
-        string memoryString;
-        int memory = 1;
-        string ioString;
-        int inputOutput = -1;
-        while (line != "EXE") {
-            jobFile >> line;
-            if (line == "NAME") {
-                jobFile >> name;
-            }
-            if (line == "LOAD") {
-                jobFile >> cycleString;
-                cycles = stoi(cycleString, nullptr, 10);
-            }
-            if (line == "PRIORITY") {
-                jobFile >> priorityString;
-                priority = stoi(priorityString, nullptr, 10);
-            }
-            if (line == "CRITICALS") {
-                jobFile >> criticalStartString;
-                criticalStart = stoi(criticalStartString, nullptr, 10);
-            }
-            if (line == "CRITICALL") {
-                jobFile >> criticalLengthString;
-                criticalLength = stoi(criticalLengthString, nullptr, 10);
-            }
-            if (line == "IO") {
-                jobFile >> ioString;
-                inputOutput = stoi(ioString);
-            }
-            if (line == "-") {
-                cout << "\n\nCreating Process from: " << path;
-                Process jobProcess = Process(numberOfProcesses, cycles, name, priority, criticalStart, criticalLength, inputOutput);
-                jobProcess.printProcess();
-                readyQueue.push(jobProcess);
-                numberOfProcesses++;
-                name = "default";
-                cycles = -1;
+    vector<Benchmark> benchmarks;
+    const char *schedulers[] = { "round", "priority", "mlfq", "fair", "srtf" };
+    const char *policies[] = { "fifo", "lru", "clock", "ws" };
+    for (int size : sizes) {
+        for (const char *scheduler : schedulers) {
+            for (int threads : threadCounts) { // one worker thread per simulated CPU
+                benchmarks.push_back(Benchmark{string("dispatch/") + scheduler, size, threads, [=](long long &ops) {
+                    unique_ptr<Simulation> sim(new Simulation());
+                    sim->generateProcesses(size);
+                    RunSummary summary = (sim.get()->*schedulerNamed(scheduler))(threads, nullptr, 0);
+                    ops = summary.dispatches;
+                    return summary.seconds;
+                }});
             }
         }
-    } else {
-        cout << "\nFile not found"; // the path did not point to a file
+        for (int policy = replaceFIFO; policy <= replaceWS; policy++) {
+            benchmarks.push_back(Benchmark{string("memory/hit-") + policies[policy], size, 1, [=](long long &ops) {
+                unique_ptr<Simulation> sim(new Simulation());
+                sim->generateProcesses(size);
+                Memory &memory = sim->MainMemory;
+                memory.resize(size, policy);
+                for (int h = 0; h < size; h++) {
+                    memory.addProcess(h);
+                }
+                vector<int> order(size * 10); // the same handles in a shuffled order
+                for (size_t i = 0; i < order.size(); i++) {
+                    order[i] = sim->random() % size;
+                }
+                auto start = chrono::steady_clock::now();
+                for (int h : order) {
+                    memory.checkMemory(h);
+                }
+                ops = order.size();
+                return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            }});
+            benchmarks.push_back(Benchmark{string("memory/evict-") + policies[policy], size, 1, [=](long long &ops) {
+                unique_ptr<Simulation> sim(new Simulation());
+                sim->generateProcesses(size);
+                Memory &memory = sim->MainMemory;
+                memory.resize(64, policy);
+                int passes = 4;
+                auto start = chrono::steady_clock::now();
+                for (int pass = 0; pass < passes; pass++) {
+                    for (int h = 0; h < size; h++) { // more processes than frames, so a miss evicts
+                        if (!memory.checkMemory(h)) {
+                            memory.addProcess(h);
+                        }
+                    }
+                }
+                ops = (long long) passes * size;
+                return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            }});
+        }
+        benchmarks.push_back(Benchmark{"memory/access", size, 1, [=](long long &ops) {
+            unique_ptr<Simulation> sim(new Simulation());
+            sim->generateProcesses(size);
+            Memory &memory = sim->MainMemory;
+            memory.resize(1024, replaceCLOCK, 1);
+            for (int h = 0; h < size; h++) { // 8 pages each, so the TLB misses and pages fault as well
+                sim->Processes.memory[h] = 8;
+            }
+            vector<int> order(size * 10);
+            for (size_t i = 0; i < order.size(); i++) {
+                order[i] = sim->random() % size;
+            }
+            auto start = chrono::steady_clock::now();
+            int from = 0;
+            for (int h : order) {
+                memory.access(0, h, from, 64);
+                from = (from + 64) % (1 << 20);
+            }
+            ops = memory.accesses;
+            return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        }});
+        for (int binary = 0; binary <= 1; binary++) {
+            benchmarks.push_back(Benchmark{binary ? "loader/binary" : "loader/text", size, 1, [=](long long &ops) {
+                string path = "/tmp/opsim-bench-" + to_string(getpid()) + (binary ? ".bin" : ".txt");
+                unique_ptr<Simulation> sim(new Simulation());
+                writeBenchJobFile(*sim, path, size, binary);
+                auto start = chrono::steady_clock::now();
+                sim->loadJobFile(path);
+                ops = sim->Processes.size();
+                double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                unlink(path.c_str());
+                return seconds;
+            }});
+        }
+        for (int threads : threadCounts) { // threads fill one table together
+            benchmarks.push_back(Benchmark{"generate", size, threads, [=](long long &ops) {
+                unique_ptr<Simulation> sim(new Simulation());
+                sim->generateThreads = threads;
+                auto start = chrono::steady_clock::now();
+                sim->generateProcesses(size);
+                ops = size;
+                return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            }});
+        }
     }
-    jobFile.close(); // closes jobFile
-    return;
+
+    if (format == "csv") {
+        cout << "benchmark,size,threads,repeat,median_ns_per_op,stddev_ns_per_op,ops_per_sec\n";
+    } else if (format == "text") {
+        cout << left << setw(22) << "benchmark" << right << setw(10) << "size" << setw(9) << "threads"
+             << setw(16) << "median ns/op" << setw(16) << "stddev ns/op" << setw(14) << "ops/s" << "\n";
+    }
+    for (Benchmark &b : benchmarks) {
+        if (!filter.empty() && b.name.find(filter) == string::npos) {
+            continue;
+        }
+        long long ops = 0;
+        b.run(ops); // warm up
+        vector<double> perOp; // nanoseconds per operation of each repetition
+        for (int i = 0; i < repeat; i++) {
+            double seconds = b.run(ops);
+            perOp.push_back(ops > 0 ? seconds * 1e9 / ops : 0);
+        }
+        sort(perOp.begin(), perOp.end());
+        double median = repeat % 2 ? perOp[repeat / 2] : (perOp[repeat / 2 - 1] + perOp[repeat / 2]) / 2;
+        double average = 0, squares = 0;
+        for (double t : perOp) {
+            average += t / repeat;
+        }
+        for (double t : perOp) {
+            squares += (t - average) * (t - average);
+        }
+        double stddev = repeat > 1 ? sqrt(squares / (repeat - 1)) : 0;
+        double rate = median > 0 ? 1e9 / median : 0;
+        if (format == "json") {
+            cout << "{\"benchmark\":\"" << b.name << "\",\"size\":" << b.size << ",\"threads\":" << b.threads << ",\"repeat\":" << repeat
+                 << ",\"median_ns_per_op\":" << median << ",\"stddev_ns_per_op\":" << stddev << ",\"ops_per_sec\":" << rate << "}\n";
+        } else if (format == "csv") {
+            cout << b.name << "," << b.size << "," << b.threads << "," << repeat << "," << median << "," << stddev << "," << rate << "\n";
+        } else {
+            cout << left << setw(22) << b.name << right << setw(10) << b.size << setw(9) << b.threads
+                 << setw(16) << median << setw(16) << stddev << setw(14) << rate << "\n";
+        }
+        cout.flush();
+    }
+    return 0;
 }
 
 int main(int argc, char* argv[]) {
     bool running = true; // is the operating system running
     string command = "";
 
+    if (argc > 1) { // any command line flags mean a headless batch run
+        string mode = argv[1];
+        int status = mode == "--sweep" ? runSweep(argc, argv) : mode == "--bench" ? runBench(argc, argv)
+            : mode == "--replay" ? runReplay(argc, argv) : runBatch(argc, argv);
+        cout.flush();
+        exit(status);
+    }
+
+    cout << "\nInitiating Memory";
     helpMenu(); // calls the help menu at the start of the application
     while (running) {
         cout << "\nPlease enter a command: ";
@@ -380,26 +5714,214 @@ int main(int argc, char* argv[]) {
         }
         else if (command.compare(0, 4, "add ") == 0) {
             string pathToJob = command.substr(4, command.length());
-            addFile(pathToJob);
+            Simulator.addFile(pathToJob);
+        }
+        else if (command.compare(0, 8, "convert ") == 0) {
+            stringstream paths(command.substr(8));
+            string textPath, binaryPath;
+            paths >> textPath >> binaryPath;
+            if (binaryPath.empty()) {
+                cout << "\nUsage: convert <text jobFile> <binary jobFile>";
+            } else {
+                Simulator.convertJobFile(textPath, binaryPath);
+            }
+        }
+        else if (command.compare(0, 8, "program ") == 0) {
+            stringstream settings(command.substr(8));
+            string path;
+            int count = 1;
+            settings >> path >> count;
+            Simulator.addProgram(path, max(0, count));
         }
         else if (command == "create process") {
-            addUserProcess(numberOfProcesses);
-            numberOfProcesses++;
+            Simulator.addUserProcess(Simulator.numberOfProcesses);
+            Simulator.numberOfProcesses++;
+        }
+        else if (command.compare(0, 4, "run ") == 0 && schedulerNamed(command.substr(4)) != nullptr) {
+            if (Simulator.paused.active) {
+                cout << "\nCarrying on the stopped run";
+            }
+            RunSummary summary = (Simulator.*schedulerNamed(command.substr(4)))(Simulator.numberOfCPUs, nullptr, 0);
+            Simulator.printSummary(summary, "text");
+        }
+        else if (command.compare(0, 7, "stream ") == 0) {
+            stringstream settings(command.substr(7));
+            string policy, source;
+            settings >> policy >> source;
+            function<void()> producer;
+            if (source == "generate") {
+                int count = 0;
+                double gap = 10;
+                settings >> count >> gap;
+                producer = [count, gap] { Simulator.streamGenerated(count, gap); };
+            } else if (!source.empty()) {
+                producer = [source] { Simulator.streamJobFile(source); };
+            }
+            if (schedulerNamed(policy) == nullptr || !producer) {
+                cout << "\nUsage: stream <round|priority|mlfq|fair|srtf> <jobFile> or stream <round|priority|mlfq|fair|srtf> generate <count> <mean gap>";
+            } else {
+                RunSummary summary = (Simulator.*schedulerNamed(policy))(Simulator.numberOfCPUs, producer, 4096);
+                Simulator.printSummary(summary, "text");
+            }
+        }
+        else if (command.compare(0, 5, "cpus ") == 0) {
+            int cpus = max(1, atoi(command.substr(5).c_str()));
+            if (Simulator.topology.fits(cpus)) {
+                Simulator.numberOfCPUs = cpus;
+                cout << "\nSchedulers will run on " << Simulator.numberOfCPUs << " CPUs";
+            } else {
+                cout << "\n" << cpus << " CPUs don't make whole caches and nodes of the topology, change it first";
+            }
+        }
+        else if (command.compare(0, 6, "boost ") == 0) {
+            Simulator.boostPeriod = max(1, atoi(command.substr(6).c_str()));
+            cout << "\nThe feedback queue boosts every " << Simulator.boostPeriod << " cycles";
         }
-        else if (command == "run round") {
-            thread one (roundRobin);
-            thread two (roundRobin);
-            one.join();
-            two.join();
+        else if (command.compare(0, 8, "metrics ") == 0) {
+            string path = command.substr(8);
+            Simulator.metricsPath = path == "off" ? "" : path;
+            cout << (path == "off" ? "\nRuns no longer write metrics" : "\nEvery run writes its metrics to " + path);
         }
-        else if (command == "run priority") {
-            priorityRobin();
+        else if (command.compare(0, 7, "record ") == 0) {
+            string path = command.substr(7);
+            Simulator.schedulePath = path == "off" ? "" : path;
+            cout << (path == "off" ? "\nRuns no longer record a schedule trace" : "\nEvery run records its schedule trace to " + path);
+        }
+        else if (command.compare(0, 7, "replay ") == 0) {
+            stringstream paths(command.substr(7));
+            string path, ganttPath;
+            paths >> path >> ganttPath;
+            ScheduleReplay replay;
+            if (replaySchedule(path, ganttPath, replay)) {
+                printReplay(replay, "text");
+            }
+        }
+        else if (command == "workload" || command.compare(0, 9, "workload ") == 0) {
+            stringstream settings(command.size() > 9 ? command.substr(9) : "");
+            string name, text;
+            settings >> name >> text;
+            Distribution *field = Simulator.workload.field(name);
+            if (!name.empty() && (field == nullptr || !parseDistribution(text, *field))) {
+                cout << "\nUsage: workload <cycles|priorities|critical-start|critical-length|io-point> <distribution>";
+            } else {
+                const char *names[] = { "cycles", "priorities", "critical-start", "critical-length", "io-point" };
+                for (const char *n : names) {
+                    cout << "\n" << n << " " << Simulator.workload.field(n)->text();
+                }
+            }
+        }
+        else if (command == "locks") {
+            Simulator.Locks.printStats();
+        }
+        else if (command.compare(0, 10, "semaphore ") == 0) {
+            stringstream settings(command.substr(10));
+            int id = -1, count = 1;
+            settings >> id >> count;
+            if (id < 0 || id >= LockTable::maxLocks) {
+                cout << "\nUsage: semaphore <lock from 0 to " << LockTable::maxLocks - 1 << "> <count>";
+            } else {
+                Simulator.Locks.locks[id].capacity = max(1, count);
+                cout << "\nLock " << id << " can be held by " << Simulator.Locks.locks[id].capacity << " processes at once";
+            }
+        }
+        else if (command.compare(0, 5, "seed ") == 0) {
+            Simulator.random = FastRandom(strtoull(command.substr(5).c_str(), nullptr, 10));
+            cout << "\nGenerated processes now come from seed " << command.substr(5);
+        }
+        else if (command.compare(0, 8, "quantum ") == 0) {
+            Simulator.quantum = max(1, atoi(command.substr(8).c_str()));
+            cout << "\nRound robin quantum is " << Simulator.quantum << " cycles";
+        }
+        else if (command.compare(0, 5, "stop ") == 0) {
+            Simulator.stopAt = max(0LL, atoll(command.substr(5).c_str()));
+            cout << (Simulator.stopAt > 0 ? "\nRuns stop at cycle " + to_string(Simulator.stopAt) : "\nRuns go on to the end");
+        }
+        else if (command.compare(0, 11, "checkpoint ") == 0) {
+            if (Simulator.saveCheckpoint(command.substr(11))) {
+                cout << "\nSaved " << Simulator.Processes.size() << " processes to " << command.substr(11);
+            }
+        }
+        else if (command.compare(0, 8, "restore ") == 0) {
+            if (Simulator.loadCheckpoint(command.substr(8))) {
+                cout << "\nRestored " << Simulator.Processes.size() << " processes from " << command.substr(8);
+                if (Simulator.paused.active) {
+                    cout << ", the next run carries on the run stopped on " << Simulator.paused.clocks.size() << " CPUs";
+                }
+            }
+        }
+        else if (command == "log quiet" || command == "log info" || command == "log debug") {
+            Trace.level = command == "log quiet" ? logQuiet : command == "log info" ? logInfo : logDebug;
+        }
+        else if (command == "memory") {
+            Simulator.MainMemory.printStats();
+        }
+        else if (command.compare(0, 7, "memory ") == 0) {
+            stringstream settings(command.substr(7));
+            int frameCount = 4;
+            string policy = "fifo";
+            int frameSize = 0;
+            settings >> frameCount >> policy >> frameSize;
+            Simulator.MainMemory.resize(frameCount, max((int) replaceFIFO, replacementNamed(policy)), frameSize);
+            Simulator.MainMemory.printStats();
+        }
+        else if (command.compare(0, 7, "paging ") == 0) {
+            stringstream settings(command.substr(7));
+            int faultCycles = 0;
+            int window = 200;
+            settings >> faultCycles >> window;
+            Simulator.MainMemory.faultCycles = max(0, faultCycles);
+            Simulator.MainMemory.workingSetWindow = max(1, window);
+            Simulator.MainMemory.printStats();
+        }
+        else if (command == "topology") {
+            cout << "\n" << Simulator.topology.text();
+        }
+        else if (command.compare(0, 9, "topology ") == 0) {
+            stringstream settings(command.substr(9));
+            Topology topology = Simulator.topology;
+            int coresPerCache = 0, cachesPerNode = 0;
+            settings >> coresPerCache >> cachesPerNode;
+            topology.coresPerCache = max(0, coresPerCache);
+            topology.cachesPerNode = max(0, cachesPerNode);
+            if (topology.fits(Simulator.numberOfCPUs)) {
+                Simulator.topology = topology;
+                cout << "\n" << topology.text();
+            } else {
+                cout << "\nThe caches and nodes have to split the " << Simulator.numberOfCPUs << " CPUs evenly";
+            }
+        }
+        else if (command.compare(0, 10, "migration ") == 0) {
+            stringstream settings(command.substr(10));
+            Topology &topology = Simulator.topology;
+            int costs[3] = { 0, 0, 0 };
+            int warmth = topology.warmth; // kept when left out
+            settings >> costs[0] >> costs[1] >> costs[2] >> warmth;
+            for (int i = 0; i < 3; i++) {
+                topology.migrationCost[i] = max(0, min(costs[i], (int) Topology::maxCost));
+            }
+            topology.warmth = max(0, warmth);
+            cout << "\n" << topology.text();
+        }
+        else if (command == "balance free" || command == "balance aware") {
+            Simulator.topology.aware = command == "balance aware";
+            cout << "\n" << Simulator.topology.text();
+        }
+        else if (command.compare(0, 6, "scale ") == 0) {
+            stringstream settings(command.substr(6));
+            string policy;
+            int cpus = 1;
+            settings >> policy >> cpus;
+            if (schedulerNamed(policy) == nullptr) {
+                cout << "\nUsage: scale <round|priority|mlfq|fair|srtf> <cpus>";
+            } else {
+                Simulator.scaleSchedulers(schedulerNamed(policy), max(1, cpus));
+            }
         }
         else if (command == "generate") {
             cout << "\nEnter the number of processes to be generated. ";
             int processes;
             cin >> processes;
-            generateProcesses(processes);
+            Simulator.generateProcesses(processes);
         }
         else if (command.compare(0, 4, "exit") ==  0) {
             cout << "\nExiting the Operating System\n";